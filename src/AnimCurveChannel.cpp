@@ -0,0 +1,171 @@
+#include "externals.h"
+
+#include "AnimCurveChannel.h"
+#include "BasicTypes.h"
+#include "MayaException.h"
+
+// Maya's time resolution
+const double mayaTimeTick = 1.0 / 141120000;
+
+bool AnimCurveChannel::tryLoad(const MPlug &plug) {
+    MStatus status;
+
+    m_curve = MObject::kNullObj;
+
+    THROW_ON_FAILURE(plug.getValue(m_staticValue));
+
+    // The compound parent (e.g. translate) must not be driven as a whole.
+    if (plug.isChild()) {
+        const MPlug parentPlug = plug.parent(&status);
+        THROW_ON_FAILURE(status);
+
+        MPlugArray parentSources;
+        if (parentPlug.connectedTo(parentSources, true, false) && parentSources.length() > 0)
+            return false;
+    }
+
+    MPlugArray sources;
+    if (!plug.connectedTo(sources, true, false) || sources.length() == 0)
+        return true;
+
+    if (sources.length() != 1)
+        return false;
+
+    MObject curveNode = sources[0].node();
+    if (!curveNode.hasFn(MFn::kAnimCurve))
+        return false;
+
+    MFnAnimCurve fnCurve(curveNode, &status);
+    THROW_ON_FAILURE(status);
+
+    const auto curveType = fnCurve.animCurveType();
+    if (curveType != MFnAnimCurve::kAnimCurveTL && curveType != MFnAnimCurve::kAnimCurveTA && curveType != MFnAnimCurve::kAnimCurveTU)
+        return false;
+
+    // The curve must use the global time, not a time-warp or driven key input.
+    MPlug inputPlug = fnCurve.findPlug("input", true, &status);
+    MPlugArray inputSources;
+    if (status && inputPlug.connectedTo(inputSources, true, false) && inputSources.length() > 0)
+        return false;
+
+    // Weighted tangents are not a polynomial in time, stepped tangents are not continuous.
+    if (fnCurve.isWeighted())
+        return false;
+
+    // Outside its keys, a cycled, oscillating or linear curve doesn't keep the value of its first or last key, so it is sampled instead.
+    if (fnCurve.preInfinityType() != MFnAnimCurve::kConstant || fnCurve.postInfinityType() != MFnAnimCurve::kConstant)
+        return false;
+
+    const auto keyCount = fnCurve.numKeys();
+    for (unsigned keyIndex = 0; keyIndex < keyCount; ++keyIndex) {
+        const auto inType = fnCurve.inTangentType(keyIndex);
+        const auto outType = fnCurve.outTangentType(keyIndex);
+        if (inType == MFnAnimCurve::kTangentStep || inType == MFnAnimCurve::kTangentStepNext || outType == MFnAnimCurve::kTangentStep ||
+            outType == MFnAnimCurve::kTangentStepNext)
+            return false;
+    }
+
+    m_curve = curveNode;
+    return true;
+}
+
+double AnimCurveChannel::evaluate(const MTime &time) const {
+    if (m_curve.isNull())
+        return m_staticValue;
+
+    MStatus status;
+    MFnAnimCurve fnCurve(m_curve, &status);
+    THROW_ON_FAILURE(status);
+
+    double value;
+    THROW_ON_FAILURE(fnCurve.evaluate(time, value));
+    return value;
+}
+
+bool AnimCurveChannel::tryGetCubicSplineKeys(gsl::span<const AnimCurveChannel> channels, const MTime &startTime, const MTime &endTime,
+                                             const double scale, const double precision, CubicSplineKeys &keys) {
+    MStatus status;
+
+    const auto dimension = static_cast<size_t>(channels.size());
+    const auto startSeconds = startTime.as(MTime::kSeconds);
+    const auto endSeconds = endTime.as(MTime::kSeconds);
+
+    // The keys of all components, inside the clip, and the clip boundaries
+    std::vector<double> keySeconds{startSeconds, endSeconds};
+
+    for (auto &channel : channels) {
+        if (channel.isAnimated()) {
+            MFnAnimCurve fnCurve(channel.m_curve, &status);
+            THROW_ON_FAILURE(status);
+
+            const auto keyCount = fnCurve.numKeys();
+            for (unsigned keyIndex = 0; keyIndex < keyCount; ++keyIndex) {
+                const auto seconds = fnCurve.time(keyIndex).as(MTime::kSeconds);
+                if (seconds > startSeconds && seconds < endSeconds) {
+                    keySeconds.push_back(seconds);
+                }
+            }
+        }
+    }
+
+    std::sort(keySeconds.begin(), keySeconds.end());
+    keySeconds.erase(std::unique(keySeconds.begin(), keySeconds.end(), [](double a, double b) { return b - a < mayaTimeTick / 2; }),
+                     keySeconds.end());
+
+    const auto keyCount = keySeconds.size();
+    const auto keyStride = 3 * dimension;
+
+    std::vector<double> values(keyCount * keyStride, 0);
+
+    const auto evaluateAt = [](const AnimCurveChannel &channel, const double seconds) {
+        return channel.evaluate(MTime(seconds, MTime::kSeconds));
+    };
+
+    for (size_t component = 0; component < dimension; ++component) {
+        auto &channel = channels[component];
+
+        values[dimension + component] = evaluateAt(channel, keySeconds[0]);
+
+        for (size_t keyIndex = 0; keyIndex + 1 < keyCount; ++keyIndex) {
+            const auto t0 = keySeconds[keyIndex];
+            const auto t3 = keySeconds[keyIndex + 1];
+            const auto duration = t3 - t0;
+
+            // Between keys, the curve is a cubic polynomial, so 4 samples define it exactly.
+            const auto f0 = evaluateAt(channel, t0);
+            const auto f1 = evaluateAt(channel, t0 + duration / 3);
+            const auto f2 = evaluateAt(channel, t0 + duration * 2 / 3);
+            const auto f3 = evaluateAt(channel, t3);
+
+            // Use a fifth sample to verify that
+            const auto fm = evaluateAt(channel, t0 + duration / 2);
+            const auto predicted = (-f0 + 9 * f1 + 9 * f2 - f3) / 16;
+            const auto magnitude = std::max({std::abs(f0), std::abs(f1), std::abs(f2), std::abs(f3), 1.0});
+            if (std::abs(predicted - fm) > 1e-7 * magnitude)
+                return false;
+
+            // The derivatives at both ends of the Lagrange polynomial
+            const auto outSlope = (-11 * f0 + 18 * f1 - 9 * f2 + 2 * f3) / (2 * duration);
+            const auto inSlope = (-2 * f0 + 9 * f1 - 18 * f2 + 11 * f3) / (2 * duration);
+
+            values[keyIndex * keyStride + 2 * dimension + component] = outSlope;
+            values[(keyIndex + 1) * keyStride + component] = inSlope;
+            values[(keyIndex + 1) * keyStride + dimension + component] = f3;
+        }
+    }
+
+    keys.times.resize(keyCount);
+    keys.values.resize(values.size());
+
+    for (size_t keyIndex = 0; keyIndex < keyCount; ++keyIndex) {
+        keys.times[keyIndex] = static_cast<float>(keySeconds[keyIndex] - startSeconds);
+
+        for (size_t offset = 0; offset < keyStride; ++offset) {
+            const auto index = keyIndex * keyStride + offset;
+            const auto isValue = offset >= dimension && offset < 2 * dimension;
+            keys.values[index] = isValue ? roundToFloat(values[index] * scale, precision) : static_cast<float>(values[index] * scale);
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "macros.h"
+
+// The CUBICSPLINE keys of a channel, in glTF layout
+struct CubicSplineKeys {
+    // The time of each key in seconds, relative to the start of the clip
+    std::vector<float> times;
+
+    // For each key, the in-tangents, the values and the out-tangents
+    std::vector<float> values;
+};
+
+// A scalar attribute that is either static, or driven directly by a single
+// time-to-value animation curve (animCurveTL, animCurveTA or animCurveTU),
+// without constraints, expressions, animation layers, ...
+class AnimCurveChannel {
+  public:
+    DEFAULT_COPY_MOVE_ASSIGN_CTOR_DTOR(AnimCurveChannel);
+
+    // Returns false when the plug is driven by something else.
+    // Curves with weighted or stepped tangents are rejected too,
+    // since these are not cubic polynomials in time.
+    bool tryLoad(const MPlug &plug);
+
+    bool isAnimated() const { return !m_curve.isNull(); }
+
+    // Evaluates the curve, without evaluating the dependency graph
+    double evaluate(const MTime &time) const;
+
+    // Converts the curves of the components of a vector attribute into exact
+    // CUBICSPLINE keys between the start and end time. Returns false if a
+    // curve is not a cubic polynomial between its keys, e.g. when it cycles.
+    static bool tryGetCubicSplineKeys(gsl::span<const AnimCurveChannel> channels, const MTime &startTime, const MTime &endTime, double scale,
+                                      double precision, CubicSplineKeys &keys);
+
+  private:
+    MObject m_curve;
+    double m_staticValue = 0;
+};
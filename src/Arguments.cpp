@@ -18,6 +18,7 @@ const auto binary = "glb";
 const auto dumpMaya = "dmy";
 const auto dumpGLTF = "dgl";
 const auto externalTextures = "ext";
+const auto linkExternalTextures = "lxt";
 const auto copyright = "cpr";
 const auto splitMeshAnimation = "sma";
 const auto splitByReference = "sbr";
@@ -64,6 +65,10 @@ const auto excludeUnusedTexcoord = "eut";
 
 const auto keepShapeNodes = "ksn";
 
+const auto mergeStaticMeshes = "msm";
+
+const auto flattenStaticHierarchy = "fsh";
+
 const auto bakeScalingFactor = "bsf";
 
 const auto forceRootNode = "frn";
@@ -72,15 +77,28 @@ const auto forceAnimationChannels = "fac";
 
 const auto forceAnimationSampling = "fas";
 
+const auto useAnimationCurves = "uac";
+
 const auto detectStepAnimations = "dsa";
 
+const auto cubicFitTolerance = "cft";
+
+const auto quantizeRotations = "qr";
+const auto quantizeWeights = "qw";
+
 const auto hashBufferURIs = "hbu";
+const auto hashImageURIs = "hiu";
 
 const auto dumpAccessorComponents = "dac";
 
 const auto niceBufferURIs = "nbu";
 
 const auto convertUnsupportedImages = "cui";
+const auto imageCacheFolder = "icf";
+const auto ktx2Textures = "ktx";
+const auto ktx2Encoder = "kte";
+const auto maxTextureSize = "mxt";
+const auto textureAtlasSize = "tas";
 
 const auto reportSkewedInverseBindMatrices = "rsb";
 
@@ -102,6 +120,8 @@ const auto matPrecision = "prm";
 
 const auto keepObjectNamespace = "kon";
 
+const auto exportGroup = "eg";
+
 } // namespace flag
 
 inline const char *getArgTypeName(const MSyntax::MArgType argType) {
@@ -152,6 +172,7 @@ SyntaxFactory::SyntaxFactory() {
     registerFlag(ss, flag::dumpMaya, "dumpMaya", kString);
     registerFlag(ss, flag::dumpAccessorComponents, "dumpAccessorComponents", kNoArg);
     registerFlag(ss, flag::externalTextures, "externalTextures", kNoArg);
+    registerFlag(ss, flag::linkExternalTextures, "linkExternalTextures", kNoArg);
     registerFlag(ss, flag::defaultMaterial, "defaultMaterial", kNoArg);
     registerFlag(ss, flag::colorizeMaterials, "colorizeMaterials", kNoArg);
     registerFlag(ss, flag::skipStandardMaterials, "skipStandardMaterials", kNoArg);
@@ -166,6 +187,9 @@ SyntaxFactory::SyntaxFactory() {
     registerFlag(ss, flag::globalOpacityFactor, "globalOpacityFactor", kDouble);
     registerFlag(ss, flag::copyright, "copyright", kString);
     registerFlag(ss, flag::detectStepAnimations, "detectStepAnimations", kLong);
+    registerFlag(ss, flag::cubicFitTolerance, "cubicFitTolerance", kDouble);
+    registerFlag(ss, flag::quantizeRotations, "quantizeRotations", kNoArg);
+    registerFlag(ss, flag::quantizeWeights, "quantizeWeights", kLong);
 
     registerFlag(ss, flag::animationClipFrameRate, "animationClipFrameRate", true, kDouble);
     registerFlag(ss, flag::animationClipName, "animationClipName", true, kString);
@@ -192,15 +216,24 @@ SyntaxFactory::SyntaxFactory() {
     registerFlag(ss, flag::ignoreSegmentScaleCompensation, "ignoreSegmentScaleCompensation", kNoArg);
 
     registerFlag(ss, flag::keepShapeNodes, "keepShapeNodes", kNoArg);
+    registerFlag(ss, flag::mergeStaticMeshes, "mergeStaticMeshes", kNoArg);
+    registerFlag(ss, flag::flattenStaticHierarchy, "flattenStaticHierarchy", kNoArg);
     registerFlag(ss, flag::bakeScalingFactor, "bakeScalingFactor", kNoArg);
     registerFlag(ss, flag::forceRootNode, "forceRootNode", kNoArg);
     registerFlag(ss, flag::forceAnimationChannels, "forceAnimationChannels", kNoArg);
     registerFlag(ss, flag::forceAnimationSampling, "forceAnimationSampling", kNoArg);
+    registerFlag(ss, flag::useAnimationCurves, "useAnimationCurves", kNoArg);
 
     registerFlag(ss, flag::hashBufferURIs, "hashBufferURI", kNoArg);
+    registerFlag(ss, flag::hashImageURIs, "hashImageURIs", kNoArg);
     registerFlag(ss, flag::niceBufferURIs, "niceBufferURIs", kNoArg);
 
     registerFlag(ss, flag::convertUnsupportedImages, "convertUnsupportedImages", kNoArg);
+    registerFlag(ss, flag::imageCacheFolder, "imageCacheFolder", kString);
+    registerFlag(ss, flag::ktx2Textures, "ktx2Textures", kNoArg);
+    registerFlag(ss, flag::ktx2Encoder, "ktx2Encoder", kString);
+    registerFlag(ss, flag::maxTextureSize, "maxTextureSize", kString);
+    registerFlag(ss, flag::textureAtlasSize, "textureAtlasSize", kLong);
     registerFlag(ss, flag::reportSkewedInverseBindMatrices, "reportSkewedInverseBindMatrices", kNoArg);
     registerFlag(ss, flag::clearOutputWindow, "clearOutputWindow", kNoArg);
 
@@ -220,6 +253,8 @@ SyntaxFactory::SyntaxFactory() {
 
     registerFlag(ss, flag::keepObjectNamespace, "keepMayaNamespaces", kNoArg);
 
+    registerFlag(ss, flag::exportGroup, "exportGroup", true, kString);
+
     m_usage = ss.str();
 }
 
@@ -480,6 +515,7 @@ Arguments::Arguments(const MArgList &args, const MSyntax &syntax) {
     dumpAccessorComponents = adb.isFlagSet(flag::dumpAccessorComponents);
 
     externalTextures = adb.isFlagSet(flag::externalTextures);
+    linkExternalTextures = adb.isFlagSet(flag::linkExternalTextures);
     splitMeshAnimation = adb.isFlagSet(flag::splitMeshAnimation);
     splitByReference = adb.isFlagSet(flag::splitByReference);
     separateAccessorBuffers = adb.isFlagSet(flag::separateAccessorBuffers);
@@ -497,17 +533,56 @@ Arguments::Arguments(const MArgList &args, const MSyntax &syntax) {
     excludeUnusedTexcoord = adb.isFlagSet(flag::excludeUnusedTexcoord);
     ignoreSegmentScaleCompensation = adb.isFlagSet(flag::ignoreSegmentScaleCompensation);
     keepShapeNodes = adb.isFlagSet(flag::keepShapeNodes);
+    mergeStaticMeshes = adb.isFlagSet(flag::mergeStaticMeshes);
+    flattenStaticHierarchy = adb.isFlagSet(flag::flattenStaticHierarchy);
     bakeScalingFactor = adb.isFlagSet(flag::bakeScalingFactor);
     forceRootNode = adb.isFlagSet(flag::forceRootNode);
     forceAnimationChannels = adb.isFlagSet(flag::forceAnimationChannels);
     forceAnimationSampling = adb.isFlagSet(flag::forceAnimationSampling);
+    useAnimationCurves = adb.isFlagSet(flag::useAnimationCurves);
     hashBufferURIs = adb.isFlagSet(flag::hashBufferURIs);
+    hashImageURIs = adb.isFlagSet(flag::hashImageURIs);
     niceBufferURIs = adb.isFlagSet(flag::niceBufferURIs);
     convertUnsupportedImages = adb.isFlagSet(flag::convertUnsupportedImages);
+    ktx2Textures = adb.isFlagSet(flag::ktx2Textures);
     reportSkewedInverseBindMatrices = adb.isFlagSet(flag::reportSkewedInverseBindMatrices);
     clearOutputWindow = adb.isFlagSet(flag::clearOutputWindow);
 
     adb.optional(flag::globalOpacityFactor, opacityFactor);
+    adb.optional(flag::imageCacheFolder, imageCacheFolder);
+    adb.optional(flag::ktx2Encoder, ktx2Encoder);
+
+    // Parse the texture size budgets, either one size for all slots, or a list like baseColor=2048,normal=1024
+    MString maxTextureSizeList;
+    if (adb.optional(flag::maxTextureSize, maxTextureSizeList)) {
+        MStringArray budgets;
+        maxTextureSizeList.split(',', budgets);
+
+        for (auto i = 0U; i < budgets.length(); ++i) {
+            const auto budget = budgets[i];
+
+            MStringArray parts;
+            budget.split('=', parts);
+
+            const auto slot = parts.length() == 2 ? TextureSlot::parse(parts[0].asChar()) : TextureSlot::INVALID;
+            const auto &size = parts.length() == 2 ? parts[1] : budget;
+
+            if (!size.isInt() || size.asInt() <= 0 || (parts.length() == 2 && slot == TextureSlot::INVALID)) {
+                const auto message = formatted("Invalid texture size '%s', expected e.g. 2048 or baseColor=2048,normal=1024", budget.asChar());
+                ArgChecker::throwInvalid(flag::maxTextureSize, message.c_str());
+            }
+
+            if (slot == TextureSlot::INVALID) {
+                maxTextureSizes.fill(size.asInt());
+            } else {
+                maxTextureSizes[slot] = size.asInt();
+            }
+        }
+    }
+
+    if (adb.optional(flag::textureAtlasSize, textureAtlasSize) && textureAtlasSize < 64) {
+        ArgChecker::throwInvalid(flag::textureAtlasSize, "Expected an atlas size of at least 64 pixels");
+    }
 
     adb.optional(flag::constantTranslationThreshold, constantTranslationThreshold);
     adb.optional(flag::constantRotationThreshold, constantRotationThreshold);
@@ -543,6 +618,13 @@ Arguments::Arguments(const MArgList &args, const MSyntax &syntax) {
     debugNormalVectors = adb.isFlagSet(flag::debugNormalVectors);
 
     adb.optional(flag::detectStepAnimations, detectStepAnimations);
+    adb.optional(flag::cubicFitTolerance, cubicFitTolerance);
+
+    quantizeRotations = adb.isFlagSet(flag::quantizeRotations);
+
+    if (adb.optional(flag::quantizeWeights, quantizeWeights) && quantizeWeights != 8 && quantizeWeights != 16) {
+        ArgChecker::throwInvalid(flag::quantizeWeights, "Expected 8 or 16 bits");
+    }
     adb.optional(flag::debugVectorLength, debugVectorLength);
     adb.optional(flag::copyright, copyright);
 
@@ -690,6 +772,67 @@ Arguments::~Arguments() {
     }
 }
 
+std::vector<MArgList> Arguments::splitExportGroups(const MArgList &args) {
+    std::vector<MArgList> groups;
+
+    const MString shortFlag = MString("-") + flag::exportGroup;
+    const MString longFlag = MString("-") + SyntaxFactory::get().longArgName(flag::exportGroup);
+
+    MStringArray otherArgs;
+
+    for (unsigned argIndex = 0; argIndex < args.length(); ++argIndex) {
+        MStatus status;
+        const auto arg = args.asString(argIndex, &status);
+        THROW_ON_FAILURE(status);
+
+        if (arg != shortFlag && arg != longFlag) {
+            otherArgs.append(arg);
+            continue;
+        }
+
+        if (++argIndex >= args.length())
+            ArgChecker::throwInvalid(flag::exportGroup, "Missing argument");
+
+        const auto groupString = args.asString(argIndex, &status);
+        THROW_ON_FAILURE(status);
+
+        // Split the group arguments at white space, keeping quoted arguments together
+        MArgList groupArgs;
+        std::string token;
+        bool hasToken = false;
+        char quote = 0;
+
+        for (const char c : std::string(groupString.asChar()) + ' ') {
+            if (quote ? c == quote : c == '"' || c == '\'') {
+                quote = quote ? 0 : c;
+                hasToken = true;
+            } else if (!quote && std::isspace(static_cast<unsigned char>(c))) {
+                if (hasToken) {
+                    if (token == shortFlag.asChar() || token == longFlag.asChar())
+                        ArgChecker::throwInvalid(flag::exportGroup, "Export groups cannot be nested");
+
+                    groupArgs.addArg(MString(token.c_str()));
+                    token.clear();
+                    hasToken = false;
+                }
+            } else {
+                token += c;
+                hasToken = true;
+            }
+        }
+
+        if (quote)
+            ArgChecker::throwInvalid(flag::exportGroup, "Unterminated quote");
+
+        groups.emplace_back(groupArgs);
+    }
+
+    if (!groups.empty() && otherArgs.length() > 0)
+        ArgChecker::throwInvalid(flag::exportGroup, formatted("Export groups cannot be combined with other arguments, like '%s'", otherArgs[0].asChar()).c_str());
+
+    return groups;
+}
+
 std::string Arguments::assignName(GLTF::Object &glObj, const MDagPath &dagPath, const MString &suffix) const {
     MStatus status;
     auto obj = dagPath.node(&status);
@@ -113,6 +113,26 @@ class Arguments {
      * converted */
     bool convertUnsupportedImages = false;
 
+    /** The folder where converted images are kept between exports, keyed by the contents of the source image.
+     * By default a Maya2glTF folder in the temporary directory is used */
+    MString imageCacheFolder;
+
+    /** Encode the textures as KTX2 with Basis Universal compression, referenced with the KHR_texture_basisu extension?
+     * Requires the toktx tool of KTX-Software. By default the images are exported as-is */
+    bool ktx2Textures = false;
+
+    /** The maximum width and height of the textures per material slot, larger images are downscaled.
+     * By default the images are exported at their full size */
+    TextureSizes maxTextureSizes{};
+
+    /** When positive, the small textures of materials that only differ by their textures are packed into atlases of at most
+     * this width and height, and these materials are merged. Textures up to a quarter of this size are atlased.
+     * By default no atlases are made */
+    int textureAtlasSize = 0;
+
+    /** The path of the toktx executable, used by ktx2Textures. By default toktx must be on the PATH */
+    MString ktx2Encoder = "toktx";
+
     /** Report skewed inverse-bind-matrix issues. glTF 2.0 does not allow these,
      * but should (see issue 1507). By default no such issues are reported */
     bool reportSkewedInverseBindMatrices = false;
@@ -136,6 +156,10 @@ class Arguments {
     /** When exporting as GLB, don't embed textures in the GLB file? */
     bool externalTextures = false;
 
+    /** Hard-link the external texture files to the source images instead of copying these,
+     * when both are on the same file system. Editing the exported textures then changes the source images! */
+    bool linkExternalTextures = false;
+
     /** By default the Maya node names are assigned to the GLTF node names */
     bool disableNameAssignment = false;
 
@@ -192,6 +216,14 @@ class Arguments {
      * node */
     bool keepShapeNodes = false;
 
+    /** Bake the world transforms of the meshes of non-animated, non-skinned nodes into their vertices, and merge these
+     * into large primitives per material and vertex layout? The nodes themselves are kept. By default each mesh is exported as-is */
+    bool mergeStaticMeshes = false;
+
+    /** Remove the non-animated transform nodes without shapes, baking their transforms into their children?
+     * Joints, parents of animated nodes and nodes with the Maya2glTF_keep attribute are kept. By default all nodes are kept */
+    bool flattenStaticHierarchy = false;
+
     /** Bake scaling factor by scaling vertices and positions? By default a root
      * scaling node is added instead */
     bool bakeScalingFactor = false;
@@ -206,13 +238,32 @@ class Arguments {
     /** Force the sampling of an animation channel for each node, even if the node doesn't contain any animation? */
     bool forceAnimationSampling = false;
 
+    /** Export translation and scaling channels that are driven directly by animation curves as exact CUBICSPLINE keys?
+     * Nodes whose transform is completely driven by such curves are evaluated without sampling the timeline. */
+    bool useAnimationCurves = false;
+
     /** Sample more frames to detect step functions in the animation? By default LINEAR interpolation is always used */
     int detectStepAnimations = 0;
 
+    /** When positive, fit CUBICSPLINE keys to the sampled frames, so that each frame component is reproduced within this tolerance.
+     * By default the sampled frames are exported with LINEAR interpolation */
+    double cubicFitTolerance = 0;
+
+    /** Store the rotation animation outputs as normalized 16-bit integers? By default floats are used */
+    bool quantizeRotations = false;
+
+    /** When 8 or 16, store the blend shape weight animation outputs as normalized integers with this number of bits, if these are within [-1,1].
+     * By default floats are used */
+    int quantizeWeights = 0;
+
     /** Use a hash of the buffer for its URI? Useful when exporting the same
      * mesh buffer per animation scene */
     bool hashBufferURIs = false;
 
+    /** Use a hash of the image contents for its URI? Identical images then get the same
+     * filename in every export, so caches can share these across assets */
+    bool hashImageURIs = false;
+
     /**
      * The time where the 'initial values' of all nodes are to be found (aka
      * neutral base pose) By default the current time is used, unless animation
@@ -269,6 +320,10 @@ class Arguments {
     /** Copyright text of the exported file */
     MString copyright;
 
+    /** Splits the command arguments into the argument lists of each -exportGroup, each with their own objects and options.
+     * Returns an empty vector when no export groups are used */
+    static std::vector<MArgList> splitExportGroups(const MArgList &args);
+
     std::string assignName(GLTF::Object &glObj, const MDagPath &dagPath, const MString &suffix) const;
     std::string assignName(GLTF::Object &glObj, const MFnDependencyNode &node, const MString &suffix) const;
 
@@ -3,9 +3,12 @@
 #include "AccessorPacker.h"
 #include "Arguments.h"
 #include "ExportableAsset.h"
+#include "ThreadPool.h"
+#include "fileCopy.h"
 #include "filesystem.h"
 #include "milo.h"
 #include "picosha2.h"
+#include "TimelineSampler.h"
 #include "progress.h"
 #include "timeControl.h"
 #include "version.h"
@@ -16,7 +19,8 @@ struct MStringComparer {
     bool operator()(const MString &a, const MString &b) const { return strcmp(a.asChar(), b.asChar()) < 0; }
 };
 
-ExportableAsset::ExportableAsset(const Arguments &args) : m_resources{args}, m_scene{m_resources} {
+ExportableAsset::ExportableAsset(const Arguments &args, TimelineSampler *sharedSampler)
+    : m_resources{args}, m_scene{m_resources}, m_ownsProgressUI{sharedSampler == nullptr} {
     m_glAsset.scenes.push_back(&m_scene.glScene);
     m_glAsset.scene = 0;
 
@@ -44,14 +48,10 @@ ExportableAsset::ExportableAsset(const Arguments &args) : m_resources{args}, m_s
 
     setCurrentTime(args.initialValuesTime, args.redrawViewport);
 
-    size_t progressStepCount = args.meshShapes.size();
-
-    for (auto &clipArg : args.animationClips) {
-        progressStepCount += clipArg.frameCount() / checkProgressFrameInterval;
+    if (m_ownsProgressUI) {
+        uiSetupProgress(progressStepCount({&args}));
     }
 
-    uiSetupProgress(progressStepCount);
-
     for (auto &dagPath : args.meshShapes) {
         uiAdvanceProgress(std::string("exporting mesh ") + dagPath.partialPathName().asChar());
         cout << prefix << "Processing mesh '" << dagPath.partialPathName().asChar() << "' ..." << endl;
@@ -64,6 +64,9 @@ ExportableAsset::ExportableAsset(const Arguments &args) : m_resources{args}, m_s
         m_scene.getNode(dagPath);
     }
 
+    // The primitives of each mesh were generated on worker threads, while the next mesh was extracted
+    m_scene.finishMeshes();
+
     if (!args.keepShapeNodes) {
         m_scene.mergeRedundantShapeNodes();
     }
@@ -73,13 +76,36 @@ ExportableAsset::ExportableAsset(const Arguments &args) : m_resources{args}, m_s
     const auto clipCount = args.animationClips.size();
 
     if (clipCount) {
+        // Forced sampling or channels ignore the static nodes, so these aren't detected then
+        if (!args.forceAnimationSampling && !args.forceAnimationChannels) {
+            m_scene.detectStaticNodes();
+        }
+
+        m_clips.reserve(clipCount);
+
         for (auto &clipArg : args.animationClips) {
-            uiAdvanceProgress("exporting clip " + clipArg.name);
-            auto clip = std::make_unique<ExportableClip>(args, clipArg, m_scene);
-            if (!clip->glAnimation.channels.empty()) {
-                m_glAsset.animations.push_back(&clip->glAnimation);
-                m_clips.emplace_back(std::move(clip));
+            m_clips.emplace_back(std::make_unique<ExportableClip>(args, clipArg, m_scene));
+        }
+
+        if (sharedSampler) {
+            // The caller samples the clips of all assets at once
+            for (auto &clip : m_clips) {
+                sharedSampler->add(*clip);
             }
+
+            // The next asset must start from the same time
+            setCurrentTime(currentFrameTime, false);
+        } else {
+            TimelineSampler sampler(args.redrawViewport);
+
+            for (auto &clip : m_clips) {
+                sampler.add(*clip);
+            }
+
+            const auto sampleTimeCount = sampler.run();
+            cout << prefix << "Evaluated " << sampleTimeCount << " distinct times for " << clipCount << " animation clips" << endl;
+
+            finishClips();
         }
     } else if (currentFrameTime != args.initialValuesTime) {
         // When we export just a single frame, we normally bake the geometry at
@@ -91,6 +117,36 @@ ExportableAsset::ExportableAsset(const Arguments &args) : m_resources{args}, m_s
         m_scene.updateCurrentValues();
     }
 
+    // The world transforms are final now, and the static nodes are known when animated
+    if (args.mergeStaticMeshes) {
+        m_staticBatch = std::make_unique<ExportableStaticBatch>(m_scene, clipCount > 0);
+    }
+
+    // After merging, the nodes of the merged meshes can be flattened too
+    if (args.flattenStaticHierarchy) {
+        m_scene.flattenStaticHierarchy(clipCount > 0);
+    }
+
+    // Atlasing rewrites the texture coordinates of the primitives, so it must follow the merging of their vertex buffers
+    if (args.textureAtlasSize > 0) {
+        std::vector<GLTF::Primitive *> primitives;
+        m_scene.getAllPrimitives(primitives);
+        if (m_staticBatch) {
+            primitives.insert(primitives.end(), m_staticBatch->glMesh.primitives.begin(), m_staticBatch->glMesh.primitives.end());
+        }
+        m_resources.atlasTextures(primitives);
+    }
+
+    std::vector<GLTF::Node *> glRootChildren;
+
+    for (auto &&pair : m_scene.orphans()) {
+        glRootChildren.push_back(&pair.second->glSecondaryNode());
+    }
+
+    if (m_staticBatch && !m_staticBatch->isEmpty()) {
+        glRootChildren.push_back(&m_staticBatch->glNode);
+    }
+
     const auto rootScaleFactor = args.getRootScaleFactor();
     if (args.forceRootNode || rootScaleFactor != 1) {
         // Create global root node for scaling.
@@ -103,15 +159,9 @@ ExportableAsset::ExportableAsset(const Arguments &args) : m_resources{args}, m_s
             trs.scale[0] = trs.scale[1] = trs.scale[2] = rootScaleFactor;
         }
 
-        for (auto &&pair : m_scene.orphans()) {
-            GLTF::Node *secondary_node = &pair.second->glSecondaryNode();
-            m_glRootNode.children.push_back(secondary_node);
-        }
+        m_glRootNode.children = glRootChildren;
     } else {
-        for (auto &&pair : m_scene.orphans()) {
-            GLTF::Node *secondary_node = &pair.second->glSecondaryNode();
-            m_scene.glScene.nodes.push_back(secondary_node);
-        }
+        m_scene.glScene.nodes.insert(m_scene.glScene.nodes.end(), glRootChildren.begin(), glRootChildren.end());
     }
 
     if (args.dumpMaya) {
@@ -119,7 +169,39 @@ ExportableAsset::ExportableAsset(const Arguments &args) : m_resources{args}, m_s
     }
 }
 
-ExportableAsset::~ExportableAsset() { uiTeardownProgress(); }
+ExportableAsset::~ExportableAsset() {
+    if (m_ownsProgressUI) {
+        uiTeardownProgress();
+    }
+}
+
+size_t ExportableAsset::progressStepCount(const std::vector<const Arguments *> &groups) {
+    size_t stepCount = 0;
+    std::vector<const AnimClipArg *> clipArgs;
+
+    for (auto args : groups) {
+        stepCount += args->meshShapes.size() + args->cameraShapes.size() + args->animationClips.size();
+
+        for (auto &clipArg : args->animationClips) {
+            clipArgs.push_back(&clipArg);
+        }
+    }
+
+    // Overlapping clips share their frames
+    return stepCount + TimelineSampler::distinctFrameCount(clipArgs) / checkProgressFrameInterval;
+}
+
+void ExportableAsset::finishClips() {
+    const auto &args = m_resources.arguments();
+
+    for (auto &clip : m_clips) {
+        uiAdvanceProgress("exporting clip " + clip->glAnimation.name);
+        clip->finish(args);
+        if (!clip->glAnimation.channels.empty()) {
+            m_glAsset.animations.push_back(&clip->glAnimation);
+        }
+    }
+}
 
 ExportableAsset::Cleanup::Cleanup() : currentTime{MAnimControl::currentTime()} {}
 
@@ -147,6 +229,55 @@ const std::string &ExportableAsset::prettyJsonString() const {
     return m_prettyJsonString;
 }
 
+// glTF only allows PNG and JPEG texture sources, so move the KTX2 sources into the KHR_texture_basisu extension.
+static std::string referenceBasisuTextures(const std::string &json) {
+    rapidjson::Document document;
+    if (document.Parse(json.c_str()).HasParseError() || !document.HasMember("textures") || !document.HasMember("images"))
+        return json;
+
+    auto &allocator = document.GetAllocator();
+    const auto &images = document["images"];
+
+    bool hasBasisuTextures = false;
+
+    for (auto &texture : document["textures"].GetArray()) {
+        if (!texture.HasMember("source"))
+            continue;
+
+        const auto &image = images[texture["source"].GetUint()];
+        const auto hasKtx2MimeType = image.HasMember("mimeType") && image["mimeType"] == "image/ktx2";
+        const auto hasKtx2Uri = image.HasMember("uri") && fs::path(image["uri"].GetString()).extension() == ".ktx2";
+        if (!hasKtx2MimeType && !hasKtx2Uri)
+            continue;
+
+        rapidjson::Value basisu(rapidjson::kObjectType);
+        basisu.AddMember("source", texture["source"], allocator);
+        texture.RemoveMember("source");
+
+        if (!texture.HasMember("extensions")) {
+            texture.AddMember("extensions", rapidjson::Value(rapidjson::kObjectType), allocator);
+        }
+        texture["extensions"].AddMember("KHR_texture_basisu", basisu, allocator);
+
+        hasBasisuTextures = true;
+    }
+
+    if (!hasBasisuTextures)
+        return json;
+
+    for (const auto name : {"extensionsUsed", "extensionsRequired"}) {
+        if (!document.HasMember(name)) {
+            document.AddMember(rapidjson::StringRef(name), rapidjson::Value(rapidjson::kArrayType), allocator);
+        }
+        document[name].PushBack("KHR_texture_basisu", allocator);
+    }
+
+    rapidjson::StringBuffer jsonStringBuffer;
+    rapidjson::Writer<rapidjson::StringBuffer> jsonWriter(jsonStringBuffer);
+    document.Accept(jsonWriter);
+    return jsonStringBuffer.GetString();
+}
+
 void ExportableAsset::save() {
     const auto &args = m_resources.arguments();
 
@@ -172,6 +303,8 @@ void ExportableAsset::save() {
     // Last try, this will throw an exception if it fails.
     create_directories(outputFolder);
 
+    m_resources.finishImages();
+
     const auto allAccessors = m_glAsset.getAllAccessors();
 
     if (args.dumpAccessorComponents) {
@@ -196,11 +329,17 @@ void ExportableAsset::save() {
         AccessorsPerDagPath meshAccessorsPerDagPath;
         m_scene.getAllAccessors(meshAccessorsPerDagPath);
 
+        // The merged meshes don't belong to a single node, nor to a single reference, so these get their own buffer
+        std::vector<GLTF::Accessor *> staticBatchAccessors;
+        if (m_staticBatch) {
+            m_staticBatch->getAllAccessors(staticBatchAccessors);
+        }
+
         // Compute animation clip accessors
         std::vector<GLTF::Accessor *> animAccessors;
 
         // Flatten mesh accessors into a set.
-        std::set<GLTF::Accessor *> meshAccessorSet;
+        std::set<GLTF::Accessor *> meshAccessorSet(staticBatchAccessors.begin(), staticBatchAccessors.end());
         for (auto &pair : meshAccessorsPerDagPath) {
             std::copy(pair.second.begin(), pair.second.end(), std::inserter(meshAccessorSet, meshAccessorSet.end()));
         }
@@ -214,6 +353,12 @@ void ExportableAsset::save() {
 
         packMeshAccessors(meshAccessorsPerDagPath, bufferPacker, packedBufferMap, "/mesh");
 
+        const auto staticBatchBufferName = sceneName + "/staticBatch/mesh";
+        const auto staticBatchBuffer = bufferPacker.packAccessors(staticBatchAccessors, staticBatchBufferName);
+        if (staticBatchBuffer) {
+            packedBufferMap[staticBatchBuffer] = staticBatchBufferName;
+        }
+
         // TODO: Also associate clips with dag-paths!
         const auto animBufferName = sceneName + "/anim";
         const auto animBuffer = bufferPacker.packAccessors(animAccessors, animBufferName);
@@ -224,6 +369,10 @@ void ExportableAsset::save() {
         // Keep every accessor separate, useful for debugging.
         auto index = 0;
         for (auto accessor : allAccessors) {
+            // Accessors without buffer view have no data
+            if (!accessor->bufferView)
+                continue;
+
             const auto name = accessor->name.empty() ? "buffer" + std::to_string(index) : accessor->name;
             accessor->bufferView->name = name;
             accessor->bufferView->buffer->name = name;
@@ -317,18 +466,37 @@ void ExportableAsset::save() {
 
     m_rawJsonString = jsonStringBuffer.GetString();
 
+    if (args.ktx2Textures) {
+        m_rawJsonString = referenceBasisuTextures(m_rawJsonString);
+    }
+
     const auto outputFilename = args.sceneName + "." + (args.glb ? args.glbFileExtension : args.gltfFileExtension);
     const auto outputPath = outputFolder / outputFilename.asChar();
 
     cout << prefix << "Writing glTF file to '" << outputPath << "'" << endl;
 
     if (!options.embeddedTextures) {
+        // External images were never loaded, so copy their files.
+        // When images have the same filename, the last one wins.
+        std::map<fs::path, fs::path> imageCopies;
         for (GLTF::Image *image : m_glAsset.getAllImages()) {
-            fs::path uri = outputFolder / image->uri;
-            std::ofstream file;
-            create(file, uri.generic_string(), ios::out | ios::binary);
-            file.write(reinterpret_cast<char *>(image->data), image->byteLength);
-            file.close();
+            imageCopies[outputFolder / image->uri] = m_resources.getImagePath(image);
+        }
+
+        const std::vector<std::pair<fs::path, fs::path>> targetSourcePairs(imageCopies.begin(), imageCopies.end());
+        const auto mode = args.linkExternalTextures ? FileCopyMode::Link : FileCopyMode::Copy;
+        const auto hashIndexFolder = m_resources.imageHashIndexFolder();
+
+        std::atomic<size_t> skippedCount{0};
+        ThreadPool::shared().parallelFor(targetSourcePairs.size(), [&](const size_t index) {
+            const auto &pair = targetSourcePairs[index];
+            if (!copyFile(pair.second, pair.first, mode, hashIndexFolder)) {
+                ++skippedCount;
+            }
+        });
+
+        if (skippedCount) {
+            cout << prefix << "Skipped " << skippedCount.load() << " up-to-date image(s)" << endl;
         }
     }
 
@@ -557,6 +725,9 @@ void ExportableAsset::dumpAccessorComponents(const std::vector<GLTF::Accessor *>
     int fileIndex = 0;
 
     for (auto &&accessor : accessors) {
+        if (!accessor->bufferView)
+            continue;
+
         switch (accessor->componentType) {
         case WebGL::FLOAT:
             dumpAccessorComponentValues<float>(accessor, fileIndex, false);
@@ -567,6 +738,15 @@ void ExportableAsset::dumpAccessorComponents(const std::vector<GLTF::Accessor *>
         case WebGL::UNSIGNED_SHORT:
             dumpAccessorComponentValues<uint16_t>(accessor, fileIndex, true);
             break;
+        case WebGL::SHORT:
+            dumpAccessorComponentValues<int16_t>(accessor, fileIndex, true);
+            break;
+        case WebGL::UNSIGNED_BYTE:
+            dumpAccessorComponentValues<uint8_t>(accessor, fileIndex, true);
+            break;
+        case WebGL::BYTE:
+            dumpAccessorComponentValues<int8_t>(accessor, fileIndex, true);
+            break;
         default:
             // TODO: Add support for other accessor component types.
             MayaException::printError("Unsupported accessor component " +
@@ -2,17 +2,27 @@
 #include "ExportableClip.h"
 #include "ExportableResources.h"
 #include "ExportableScene.h"
+#include "ExportableStaticBatch.h"
 
 class Arguments;
+class TimelineSampler;
 
 // A packed buffer and a filename hint.
 typedef std::map<GLTF::Buffer *, std::string> PackedBufferMap;
 
 class ExportableAsset {
   public:
-    ExportableAsset(const Arguments &args);
+    // Extracts the objects and animation clips. Unless a shared sampler is given, the clips are sampled immediately,
+    // otherwise they are added to the sampler, and finishClips must be called after running it.
+    ExportableAsset(const Arguments &args, TimelineSampler *sharedSampler = nullptr);
     ~ExportableAsset();
 
+    // The number of progress steps the export of these groups takes, when their clips are sampled by the same sampler
+    static size_t progressStepCount(const std::vector<const Arguments *> &groups);
+
+    // Creates the glTF animations, after the clips are sampled
+    void finishClips();
+
     const std::string &prettyJsonString() const;
 
     void save();
@@ -40,6 +50,12 @@ class ExportableAsset {
     // std::vector<std::unique_ptr<ExportableItem>> m_items;
     std::vector<std::unique_ptr<ExportableClip>> m_clips;
 
+    // The merged meshes of the static nodes, when merging static meshes
+    std::unique_ptr<ExportableStaticBatch> m_staticBatch;
+
+    // When sharing a sampler, the caller shows the progress of all assets
+    const bool m_ownsProgressUI;
+
     std::string m_rawJsonString;
     mutable std::string m_prettyJsonString;
 
@@ -2,15 +2,13 @@
 
 #include "ExportableClip.h"
 #include "ExportableNode.h"
-#include "progress.h"
-#include "timeControl.h"
+#include "ThreadPool.h"
 
 ExportableClip::ExportableClip(const Arguments &args, const AnimClipArg &clipArg, const ExportableScene &scene)
-    : m_frames(args.makeName(clipArg.name + "/anim/frames"), clipArg.frameCount(), clipArg.framesPerSecond) {
+    : m_frames(args.makeName(clipArg.name + "/anim/frames"), clipArg.startTime, clipArg.frameCount(), clipArg.framesPerSecond),
+      m_stepDetectSampleCount(args.getStepDetectSampleCount()) {
     glAnimation.name = clipArg.name;
 
-    const auto stepDetectSampleCount = args.getStepDetectSampleCount();
-    const auto frameCount = m_frames.count;
     const auto scaleFactor = args.getBakeScaleFactor();
 
     auto &items = scene.table();
@@ -19,38 +17,62 @@ ExportableClip::ExportableClip(const Arguments &args, const AnimClipArg &clipArg
 
     for (auto &pair : items) {
         auto &node = pair.second;
+        if (node->isStatic && !args.forceAnimationSampling && !args.forceAnimationChannels)
+            continue;
+
         auto nodeAnimation = node->createAnimation(args, m_frames, scaleFactor);
         if (nodeAnimation) {
             m_nodeAnimations.emplace_back(std::move(nodeAnimation));
         }
     }
+}
 
-    const auto superSampleFrameRate = stepDetectSampleCount * clipArg.framesPerSecond;
+ExportableClip::~ExportableClip() = default;
+
+static MTime sampleTime(const MTime &startTime, const double framesPerSecond, const int stepDetectSampleCount, const int relativeFrameIndex,
+                        const int superSampleIndex) {
+    const auto superSampleFrameRate = stepDetectSampleCount * framesPerSecond;
 
     // To make sure Maya never rounds to just before a frame, we add half the smallest time step. Need to detect step interpolation
     const double mayaTimeEpsilon = 0.5 / 141120000;
 
-    for (size_t relativeFrameIndex = 0; relativeFrameIndex < frameCount; ++relativeFrameIndex) {
-        for (size_t superSampleIndex = 0; superSampleIndex < stepDetectSampleCount; ++superSampleIndex) {
-            const double relativeFrameTime = (relativeFrameIndex * stepDetectSampleCount + superSampleIndex) / superSampleFrameRate + mayaTimeEpsilon;
-            const MTime absoluteFrameTime = clipArg.startTime + MTime(relativeFrameTime, MTime::kSeconds);
-            setCurrentTime(absoluteFrameTime, args.redrawViewport && superSampleIndex == 0);
-            // const auto absoluteFrameTimeDebug = MAnimControl::currentTime().as(MTime::k24FPS);
-
-            NodeTransformCache transformCache;
-            for (auto &nodeAnimation : m_nodeAnimations) {
-                nodeAnimation->sampleAt(absoluteFrameTime, relativeFrameIndex, superSampleIndex, transformCache);
-            }
-        }
+    const double relativeFrameTime = (relativeFrameIndex * stepDetectSampleCount + superSampleIndex) / superSampleFrameRate + mayaTimeEpsilon;
+    return startTime + MTime(relativeFrameTime, MTime::kSeconds);
+}
+
+MTime ExportableClip::sampleTime(const int relativeFrameIndex, const int superSampleIndex) const {
+    return ::sampleTime(m_frames.startTime, m_frames.framesPerSecond, m_stepDetectSampleCount, relativeFrameIndex, superSampleIndex);
+}
+
+MTime ExportableClip::frameTime(const AnimClipArg &clipArg, const int relativeFrameIndex) {
+    return ::sampleTime(clipArg.startTime, clipArg.framesPerSecond, 1, relativeFrameIndex, 0);
+}
 
-        if (relativeFrameIndex % checkProgressFrameInterval == checkProgressFrameInterval - 1) {
-            uiAdvanceProgress("exporting clip '" + clipArg.name + formatted("' %d%%", relativeFrameIndex * 100 / frameCount));
+bool ExportableClip::requiresTimeline() const {
+    return std::any_of(m_nodeAnimations.begin(), m_nodeAnimations.end(),
+                       [](const std::unique_ptr<NodeAnimation> &nodeAnimation) { return nodeAnimation->requiresTimeline(); });
+}
+
+void ExportableClip::sampleAt(const MTime &absoluteTime, const int relativeFrameIndex, const int superSampleIndex,
+                              NodeTransformCache &transformCache) {
+    for (auto &nodeAnimation : m_nodeAnimations) {
+        nodeAnimation->sampleAt(absoluteTime, relativeFrameIndex, superSampleIndex, transformCache);
+    }
+}
+
+void ExportableClip::finish(const Arguments &args) {
+    // Fitting only needs the samples, not Maya, so all channels are fitted in parallel.
+    if (args.cubicFitTolerance > 0 && !args.forceAnimationSampling) {
+        std::vector<PropAnimation *> props;
+        for (auto &nodeAnimation : m_nodeAnimations) {
+            nodeAnimation->collectProps(props);
         }
+
+        const auto tolerance = args.cubicFitTolerance;
+        ThreadPool::shared().parallelFor(props.size(), [&](const size_t index) { props[index]->fitCubicSplineKeys(tolerance); });
     }
 
     for (auto &nodeAnimation : m_nodeAnimations) {
         nodeAnimation->exportTo(glAnimation);
     }
 }
-
-ExportableClip::~ExportableClip() = default;
@@ -6,13 +6,35 @@
 
 class ExportableClip {
   public:
+    // Creates the animations of the scene nodes, these are sampled by a TimelineSampler.
     ExportableClip(const Arguments &args, const AnimClipArg &clipArg, const ExportableScene &scene);
     virtual ~ExportableClip();
 
     GLTF::Animation glAnimation;
 
+    int frameCount() const { return m_frames.count; }
+
+    int stepDetectSampleCount() const { return m_stepDetectSampleCount; }
+
+    // The absolute time of a frame, or of one of its step-detection super-samples
+    MTime sampleTime(int relativeFrameIndex, int superSampleIndex) const;
+
+    // The absolute time of a frame of the clip, before the clip is created
+    static MTime frameTime(const AnimClipArg &clipArg, int relativeFrameIndex);
+
+    // Must the Maya timeline be set to the sample times?
+    // False when all animations are evaluated directly from animation curves.
+    bool requiresTimeline() const;
+
+    // Samples all node animations. The frames and their super-samples must be sampled in order.
+    void sampleAt(const MTime &absoluteTime, int relativeFrameIndex, int superSampleIndex, NodeTransformCache &transformCache);
+
+    // Creates the glTF animation channels, after all frames are sampled.
+    void finish(const Arguments &args);
+
   private:
     ExportableFrames m_frames;
+    const int m_stepDetectSampleCount;
     std::vector<std::unique_ptr<NodeAnimation>> m_nodeAnimations;
 
     DISALLOW_COPY_MOVE_ASSIGN(ExportableClip);
@@ -4,9 +4,10 @@
 #include "accessors.h"
 
 ExportableFrames::ExportableFrames(std::string accessorName,
+                                   const MTime &startTime,
                                    const int frameCount,
                                    const double framesPerSecond)
-    : count(frameCount), m_accessorName(std::move(accessorName)) {
+    : count(frameCount), startTime(startTime), framesPerSecond(framesPerSecond), m_accessorName(std::move(accessorName)) {
     m_glTimes.reserve(frameCount);
 
     for (auto relativeFrameIndex = 0; relativeFrameIndex < frameCount; ++relativeFrameIndex) {
@@ -4,11 +4,22 @@
 
 class ExportableFrames {
   public:
-    ExportableFrames(std::string accessorName, int frameCount, double framesPerSecond);
+    ExportableFrames(std::string accessorName, const MTime &startTime, int frameCount, double framesPerSecond);
     ~ExportableFrames() = default;
 
     const int count;
 
+    // The absolute time of the first frame
+    const MTime startTime;
+
+    const double framesPerSecond;
+
+    // The absolute time of the last frame
+    MTime endTime() const { return startTime + MTime((count - 1) / framesPerSecond, MTime::kSeconds); }
+
+    // For each animation frame, the clip-relative time in seconds.
+    gsl::span<const float> times() const { return gsl::make_span(m_glTimes); }
+
     GLTF::Accessor *glInputs() const;
 
     GLTF::Accessor *glInput0() const;
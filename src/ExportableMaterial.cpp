@@ -8,6 +8,39 @@
 #include "MayaException.h"
 #include "filesystem.h"
 
+namespace MaterialTexture {
+const char *name(const Kind kind) {
+    switch (kind) {
+    case BASE_COLOR:
+        return "baseColor";
+    case METALLIC_ROUGHNESS:
+        return "metallicRoughness";
+    case NORMAL:
+        return "normal";
+    case OCCLUSION:
+        return "occlusion";
+    case EMISSIVE:
+        return "emissive";
+    default:
+        assert(false);
+        return "unknown";
+    }
+}
+
+TextureSlot::Kind slot(const Kind kind) {
+    switch (kind) {
+    case BASE_COLOR:
+        return TextureSlot::BASE_COLOR;
+    case NORMAL:
+        return TextureSlot::NORMAL;
+    case EMISSIVE:
+        return TextureSlot::EMISSIVE;
+    default:
+        return TextureSlot::ORM;
+    }
+}
+} // namespace MaterialTexture
+
 ExportableMaterial::ExportableMaterial() = default;
 ExportableMaterial::~ExportableMaterial() = default;
 
@@ -35,7 +68,7 @@ bool ExportableMaterial::tryCreateNormalTexture(ExportableResources &resources,
     if (!outputTexture)
         return false;
 
-    outputTexture = ExportableTexture::tryLoad(resources, normalCamera, "bumpValue");
+    outputTexture = ExportableTexture::tryLoad(resources, normalCamera, "bumpValue", TextureSlot::NORMAL);
     return outputTexture != nullptr;
 }
 
@@ -70,6 +103,130 @@ bool ExportableMaterialBasePBR::hasTextures() const {
            m_glEmissiveTexture.texture || m_glOcclusionTexture.texture;
 }
 
+MaterialTextures ExportableMaterialBasePBR::textures() const {
+    MaterialTextures result{};
+
+    const auto metallicRoughness = m_glMaterial.metallicRoughness;
+    if (metallicRoughness && metallicRoughness->baseColorTexture) {
+        result[MaterialTexture::BASE_COLOR] = metallicRoughness->baseColorTexture->texture;
+    }
+    if (metallicRoughness && metallicRoughness->metallicRoughnessTexture) {
+        result[MaterialTexture::METALLIC_ROUGHNESS] = metallicRoughness->metallicRoughnessTexture->texture;
+    }
+    if (m_glMaterial.normalTexture) {
+        result[MaterialTexture::NORMAL] = m_glMaterial.normalTexture->texture;
+    }
+    if (m_glMaterial.occlusionTexture) {
+        result[MaterialTexture::OCCLUSION] = m_glMaterial.occlusionTexture->texture;
+    }
+    if (m_glMaterial.emissiveTexture) {
+        result[MaterialTexture::EMISSIVE] = m_glMaterial.emissiveTexture->texture;
+    }
+    return result;
+}
+
+bool ExportableMaterialBasePBR::hasSameFactors(const ExportableMaterialBasePBR &other) const {
+    const auto &a = m_glMaterial;
+    const auto &b = other.m_glMaterial;
+
+    if ((a.metallicRoughness == nullptr) != (b.metallicRoughness == nullptr) || (a.emissiveFactor == nullptr) != (b.emissiveFactor == nullptr))
+        return false;
+
+    if (a.metallicRoughness) {
+        const auto &amr = *a.metallicRoughness;
+        const auto &bmr = *b.metallicRoughness;
+        if ((amr.baseColorFactor == nullptr) != (bmr.baseColorFactor == nullptr) || amr.metallicFactor != bmr.metallicFactor ||
+            amr.roughnessFactor != bmr.roughnessFactor)
+            return false;
+
+        if (amr.baseColorFactor && m_glBaseColorFactor != other.m_glBaseColorFactor)
+            return false;
+    }
+
+    if (a.emissiveFactor && m_glEmissiveFactor != other.m_glEmissiveFactor)
+        return false;
+
+    return a.alphaMode == b.alphaMode && a.doubleSided == b.doubleSided && m_glNormalTexture.scale == other.m_glNormalTexture.scale &&
+           m_glOcclusionTexture.strength == other.m_glOcclusionTexture.strength;
+}
+
+void ExportableMaterialBasePBR::removeTextures(const std::set<const GLTF::Image *> &images) {
+    const auto isRemoved = [&images](const GLTF::MaterialPBR::Texture &info) { return info.texture && images.count(info.texture->source); };
+
+    if (isRemoved(m_glBaseColorTexture)) {
+        m_glBaseColorTexture.texture = nullptr;
+        m_glMetallicRoughness.baseColorTexture = nullptr;
+    }
+    if (isRemoved(m_glMetallicRoughnessTexture)) {
+        m_glMetallicRoughnessTexture.texture = nullptr;
+        m_glMetallicRoughness.metallicRoughnessTexture = nullptr;
+    }
+    if (isRemoved(m_glNormalTexture)) {
+        m_glNormalTexture.texture = nullptr;
+        m_glMaterial.normalTexture = nullptr;
+    }
+    if (isRemoved(m_glOcclusionTexture)) {
+        m_glOcclusionTexture.texture = nullptr;
+        m_glMaterial.occlusionTexture = nullptr;
+    }
+    if (isRemoved(m_glEmissiveTexture)) {
+        m_glEmissiveTexture.texture = nullptr;
+        m_glMaterial.emissiveTexture = nullptr;
+    }
+}
+
+void ExportableMaterialBasePBR::copyFrom(const ExportableMaterialBasePBR &other, const MaterialTextures &textures) {
+    m_glBaseColorFactor = other.m_glBaseColorFactor;
+    m_glEmissiveFactor = other.m_glEmissiveFactor;
+
+    m_glMetallicRoughness.metallicFactor = other.m_glMetallicRoughness.metallicFactor;
+    m_glMetallicRoughness.roughnessFactor = other.m_glMetallicRoughness.roughnessFactor;
+    if (other.m_glMetallicRoughness.baseColorFactor) {
+        m_glMetallicRoughness.baseColorFactor = &m_glBaseColorFactor[0];
+    }
+
+    if (other.m_glMaterial.metallicRoughness) {
+        m_glMaterial.metallicRoughness = &m_glMetallicRoughness;
+    }
+    if (other.m_glMaterial.emissiveFactor) {
+        m_glMaterial.emissiveFactor = &m_glEmissiveFactor[0];
+    }
+
+    m_glMaterial.alphaMode = other.m_glMaterial.alphaMode;
+    m_glMaterial.doubleSided = other.m_glMaterial.doubleSided;
+    m_glNormalTexture.scale = other.m_glNormalTexture.scale;
+    m_glOcclusionTexture.strength = other.m_glOcclusionTexture.strength;
+
+    if (textures[MaterialTexture::BASE_COLOR]) {
+        m_glBaseColorTexture.texture = textures[MaterialTexture::BASE_COLOR];
+        m_glMetallicRoughness.baseColorTexture = &m_glBaseColorTexture;
+    }
+    if (textures[MaterialTexture::METALLIC_ROUGHNESS]) {
+        m_glMetallicRoughnessTexture.texture = textures[MaterialTexture::METALLIC_ROUGHNESS];
+        m_glMetallicRoughness.metallicRoughnessTexture = &m_glMetallicRoughnessTexture;
+    }
+    if (textures[MaterialTexture::NORMAL]) {
+        m_glNormalTexture.texture = textures[MaterialTexture::NORMAL];
+        m_glMaterial.normalTexture = &m_glNormalTexture;
+    }
+    if (textures[MaterialTexture::OCCLUSION]) {
+        m_glOcclusionTexture.texture = textures[MaterialTexture::OCCLUSION];
+        m_glMaterial.occlusionTexture = &m_glOcclusionTexture;
+    }
+    if (textures[MaterialTexture::EMISSIVE]) {
+        m_glEmissiveTexture.texture = textures[MaterialTexture::EMISSIVE];
+        m_glMaterial.emissiveTexture = &m_glEmissiveTexture;
+    }
+}
+
+ExportableAtlasMaterial::ExportableAtlasMaterial(const std::string &name, const ExportableMaterialBasePBR &prototype,
+                                                 const MaterialTextures &atlasTextures) {
+    m_glMaterial.name = name;
+    copyFrom(prototype, atlasTextures);
+}
+
+ExportableAtlasMaterial::~ExportableAtlasMaterial() = default;
+
 ExportableMaterialPBR::ExportableMaterialPBR(ExportableResources &resources, const MFnDependencyNode &shaderNode) {
     MStatus status;
 
@@ -117,7 +274,7 @@ void ExportableMaterialPBR::convert(ExportableResources &resources, const MObjec
     m_glMetallicRoughness.metallicFactor = 0;
     m_glMaterial.metallicRoughness = &m_glMetallicRoughness;
 
-    const auto colorTexture = ExportableTexture::tryLoad(resources, shaderObject, "color");
+    const auto colorTexture = ExportableTexture::tryLoad(resources, shaderObject, "color", TextureSlot::BASE_COLOR);
     if (colorTexture) {
         m_glBaseColorTexture.texture = colorTexture;
         m_glMetallicRoughness.baseColorTexture = &m_glBaseColorTexture;
@@ -196,7 +353,7 @@ void ExportableMaterialPBR::loadPBR(ExportableResources &resources, const MFnDep
         m_glMaterial.alphaMode = "BLEND";
     }
 
-    const auto baseColorTexture = ExportableTexture::tryLoad(resources, shaderObject, "u_BaseColorTexture");
+    const auto baseColorTexture = ExportableTexture::tryLoad(resources, shaderObject, "u_BaseColorTexture", TextureSlot::BASE_COLOR);
     if (baseColorTexture) {
         m_glBaseColorTexture.texture = baseColorTexture;
         m_glMetallicRoughness.baseColorTexture = &m_glBaseColorTexture;
@@ -217,11 +374,15 @@ void ExportableMaterialPBR::loadPBR(ExportableResources &resources, const MFnDep
         m_glMaterial.metallicRoughness = &m_glMetallicRoughness;
     }
 
-    const auto roughnessTexture = ExportableTexture::tryCreate(resources, shaderObject, "u_RoughnessTexture");
-    const auto metallicTexture = ExportableTexture::tryCreate(resources, shaderObject, "u_MetallicTexture");
+    // Packed source images are not exported, so these are only loaded when used as-is
+    const auto roughnessTexture = ExportableTexture::tryResolve(resources, shaderObject, "u_RoughnessTexture", TextureSlot::ORM);
+    const auto metallicTexture = ExportableTexture::tryResolve(resources, shaderObject, "u_MetallicTexture", TextureSlot::ORM);
+    const auto occlusionTexture = ExportableTexture::tryResolve(resources, shaderObject, "u_OcclusionTexture", TextureSlot::ORM);
     if (roughnessTexture || metallicTexture) {
-        status = tryCreateRoughnessMetalnessTexture(resources, metallicTexture.get(), roughnessTexture.get(), status);
-        m_glMetallicRoughness.metallicRoughnessTexture = &m_glMetallicRoughnessTexture;
+        status = tryCreateRoughnessMetalnessTexture(resources, metallicTexture.get(), roughnessTexture.get(), occlusionTexture.get(), status);
+        if (m_glMetallicRoughnessTexture.texture) {
+            m_glMetallicRoughness.metallicRoughnessTexture = &m_glMetallicRoughnessTexture;
+        }
     }
 
     // Emissive
@@ -230,7 +391,7 @@ void ExportableMaterialPBR::loadPBR(ExportableResources &resources, const MFnDep
         m_glMaterial.emissiveFactor = &m_glEmissiveFactor[0];
     }
 
-    const auto emissiveTexture = ExportableTexture::tryLoad(resources, shaderObject, "u_EmissiveTexture");
+    const auto emissiveTexture = ExportableTexture::tryLoad(resources, shaderObject, "u_EmissiveTexture", TextureSlot::EMISSIVE);
     if (emissiveTexture) {
         m_glEmissiveTexture.texture = emissiveTexture;
         m_glMaterial.emissiveTexture = &m_glEmissiveTexture;
@@ -239,16 +400,20 @@ void ExportableMaterialPBR::loadPBR(ExportableResources &resources, const MFnDep
     // Ambient occlusion
     getScalar(shaderObject, "u_OcclusionStrength", m_glOcclusionTexture.strength);
 
-    const auto occlusionTexture = ExportableTexture::tryLoad(resources, shaderObject, "u_OcclusionTexture");
     if (occlusionTexture) {
-        m_glOcclusionTexture.texture = occlusionTexture;
-        m_glMaterial.occlusionTexture = &m_glOcclusionTexture;
+        // Unless it was packed with the roughness and metallic textures
+        if (!m_glOcclusionTexture.texture) {
+            m_glOcclusionTexture.texture = occlusionTexture->load(resources);
+        }
+        if (m_glOcclusionTexture.texture) {
+            m_glMaterial.occlusionTexture = &m_glOcclusionTexture;
+        }
     }
 
     // Normal
     getScalar(shaderObject, "u_NormalScale", m_glNormalTexture.scale);
 
-    const auto normalTexture = ExportableTexture::tryLoad(resources, shaderObject, "u_NormalTexture");
+    const auto normalTexture = ExportableTexture::tryLoad(resources, shaderObject, "u_NormalTexture", TextureSlot::NORMAL);
     if (normalTexture) {
         m_glNormalTexture.texture = normalTexture;
         m_glMaterial.normalTexture = &m_glNormalTexture;
@@ -286,70 +451,38 @@ ExportableDebugMaterial::ExportableDebugMaterial(const Float3 &hsv) {
 ExportableDebugMaterial::~ExportableDebugMaterial() = default;
 
 MStatus ExportableMaterialPBR::tryCreateRoughnessMetalnessTexture(ExportableResources &resources,
-                                                                  const ExportableTexture *metallicTexture,
-                                                                  const ExportableTexture *roughnessTexture,
+                                                                  ExportableTexture *metallicTexture,
+                                                                  ExportableTexture *roughnessTexture,
+                                                                  ExportableTexture *occlusionTexture,
                                                                   MStatus status) {
-    // TODO: Test this code!
-    if (!metallicTexture || roughnessTexture->glTexture == metallicTexture->glTexture) {
-        m_glMetallicRoughnessTexture.texture = roughnessTexture->glTexture;
+    // The textures are only resolved, a source image is only loaded when it is used as-is
+    if (!metallicTexture || (roughnessTexture && roughnessTexture->isSameAs(*metallicTexture))) {
+        m_glMetallicRoughnessTexture.texture = roughnessTexture->load(resources);
     } else if (!roughnessTexture) {
-        m_glMetallicRoughnessTexture.texture = metallicTexture->glTexture;
+        m_glMetallicRoughnessTexture.texture = metallicTexture->load(resources);
     } else {
-        cerr << prefix << "WARNING: Merging roughness and metallic into one texture" << endl;
-
-        MImage metallicImage;
-        MImage roughnessImage;
-
-        THROW_ON_FAILURE_WITH(
-            metallicImage.readFromTextureNode(metallicTexture->connectedObject),
-            formatted("Failed to read metallic texture '%s'", metallicTexture->imageFilePath.asChar()));
-
-        THROW_ON_FAILURE_WITH(
-            roughnessImage.readFromTextureNode(roughnessTexture->connectedObject),
-            formatted("Failed to read roughness texture '%s'", roughnessTexture->imageFilePath.asChar()));
-
-        unsigned width;
-        unsigned height;
-        THROW_ON_FAILURE(metallicImage.getSize(width, height));
-
-        unsigned width2;
-        unsigned height2;
-        THROW_ON_FAILURE(roughnessImage.getSize(width2, height2));
-
-        if (width != width2 || height != height2) {
-            MayaException::printError(formatted("Images '%s' and '%s' have different size, not merging",
-                                                metallicTexture->imageFilePath.asChar(),
-                                                roughnessTexture->imageFilePath.asChar()));
-        } else {
-            // Merge metallic into roughness
-            auto metallicPixels = reinterpret_cast<uint32_t *>(metallicImage.pixels());
-            auto roughnessPixels = reinterpret_cast<uint32_t *>(roughnessImage.pixels());
-            int64_t pixelCount = width * height;
-            while (--pixelCount >= 0) {
-                *roughnessPixels++ = (*roughnessPixels & 0xff00) | (*metallicPixels++ & 0xff0000) | 0xff000000;
-            }
-
-            // TODO: Add argument for output image file mime-type
-            const fs::path roughnessPath{roughnessTexture->imageFilePath.asChar()};
-            const fs::path metallicPath{metallicTexture->imageFilePath.asChar()};
-            const fs::path imageExtension{roughnessPath.extension()};
-            fs::path imageFilename{roughnessPath.stem().string() + "-" + metallicPath.stem().string()};
-            imageFilename.replace_extension(imageExtension);
-            MString mergedImagePath{(fs::temp_directory_path() / imageFilename).c_str()};
-
-            cout << prefix << "Saving merged roughness-metallic texture to " << mergedImagePath << endl;
-            status = roughnessImage.writeToFile(mergedImagePath, imageExtension.c_str());
-            THROW_ON_FAILURE_WITH(status, formatted("Failed to write merged "
-                                                    "metallic-roughness texture to '%s'",
-                                                    mergedImagePath.asChar()));
+        // An occlusion texture with the same sampler is packed too, so both textures share one image.
+        const auto packOcclusion = occlusionTexture && occlusionTexture->glSampler == roughnessTexture->glSampler;
 
-            const auto imagePtr = resources.getImage(mergedImagePath.asChar());
-            assert(imagePtr);
+        const fs::path occlusionPath{packOcclusion ? occlusionTexture->imageFilePath.asChar() : ""};
+        const fs::path roughnessPath{roughnessTexture->imageFilePath.asChar()};
+        const fs::path metallicPath{metallicTexture->imageFilePath.asChar()};
 
+        const auto maxSize = resources.arguments().maxTextureSizes[TextureSlot::ORM];
+        const auto imagePtr = resources.getPackedImage(occlusionPath, roughnessPath, metallicPath, maxSize);
+        if (imagePtr) {
             const auto texturePtr = resources.getTexture(imagePtr, roughnessTexture->glSampler);
             assert(texturePtr);
 
             m_glMetallicRoughnessTexture.texture = texturePtr;
+
+            if (packOcclusion) {
+                m_glOcclusionTexture.texture = texturePtr;
+            }
+        } else {
+            MayaException::printError(formatted("Failed to pack '%s' and '%s', using the roughness texture only",
+                                                roughnessTexture->imageFilePath.asChar(), metallicTexture->imageFilePath.asChar()));
+            m_glMetallicRoughnessTexture.texture = roughnessTexture->load(resources);
         }
     }
     return status;
@@ -387,22 +520,13 @@ void ExportableMaterialPBR::loadAiStandard(
     }
 
     bool hasTransparency = false;
-    const auto baseColorTexture = ExportableTexture::tryLoad(resources, shaderObject, "baseColor");
+    const auto baseColorTexture = ExportableTexture::tryLoad(resources, shaderObject, "baseColor", TextureSlot::BASE_COLOR);
     if (baseColorTexture) {
         m_glBaseColorTexture.texture = baseColorTexture;
         m_glMetallicRoughness.baseColorTexture = &m_glBaseColorTexture;
 
-        unsigned baseColorWidth = baseColorTexture->source->getDimensions().first;
-        unsigned baseColorHeight = baseColorTexture->source->getDimensions().second;
-        uint32_t *baseColorPixels = reinterpret_cast<uint32_t *>(baseColorTexture->source->data);
-        int64_t pixelCount = baseColorWidth * baseColorHeight;
-        if (pixelCount) {
-            while (--pixelCount >= 0) {
-                // Check if the alpha is opaque
-                uint8_t *pixel = reinterpret_cast<uint8_t *>(baseColorPixels);
-                hasTransparency = hasTransparency || pixel[3] != 255;
-            }
-        }
+        // The image data is loaded later, so only the alpha channel of the format is known here.
+        hasTransparency = resources.getImageMetadata(baseColorTexture->source).hasAlpha;
     }
 
     if (customBaseColor[3] != 1.0f || hasTransparency) {
@@ -420,12 +544,14 @@ void ExportableMaterialPBR::loadAiStandard(
         m_glMaterial.metallicRoughness = &m_glMetallicRoughness;
     }
 
-    const auto roughnessTexture = ExportableTexture::tryCreate(resources, shaderObject, "specularRoughness");
-    const auto metallicTexture = ExportableTexture::tryCreate(resources, shaderObject, "metalness");
+    const auto roughnessTexture = ExportableTexture::tryResolve(resources, shaderObject, "specularRoughness", TextureSlot::ORM);
+    const auto metallicTexture = ExportableTexture::tryResolve(resources, shaderObject, "metalness", TextureSlot::ORM);
     if (roughnessTexture || metallicTexture) {
-        status = tryCreateRoughnessMetalnessTexture(resources, metallicTexture.get(), roughnessTexture.get(), status);
+        status = tryCreateRoughnessMetalnessTexture(resources, metallicTexture.get(), roughnessTexture.get(), nullptr, status);
 
-        m_glMetallicRoughness.metallicRoughnessTexture = &m_glMetallicRoughnessTexture;
+        if (m_glMetallicRoughnessTexture.texture) {
+            m_glMetallicRoughness.metallicRoughnessTexture = &m_glMetallicRoughnessTexture;
+        }
     }
 
     // Emissive color
@@ -434,7 +560,7 @@ void ExportableMaterialPBR::loadAiStandard(
         m_glMaterial.emissiveFactor = &m_glEmissiveFactor[0];
     }
 
-    const auto emissiveTexture = ExportableTexture::tryLoad(resources, shaderObject, "emissionColor");
+    const auto emissiveTexture = ExportableTexture::tryLoad(resources, shaderObject, "emissionColor", TextureSlot::EMISSIVE);
     if (emissiveTexture) {
         m_glEmissiveTexture.texture = emissiveTexture;
         m_glMaterial.emissiveTexture = &m_glEmissiveTexture;
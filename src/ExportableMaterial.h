@@ -6,6 +6,18 @@
 
 class ExportableResources;
 
+// The textures of a glTF PBR material
+namespace MaterialTexture {
+enum Kind { BASE_COLOR, METALLIC_ROUGHNESS, NORMAL, OCCLUSION, EMISSIVE, COUNT };
+
+const char *name(Kind kind);
+
+// The slot of the texture size budgets
+TextureSlot::Kind slot(Kind kind);
+} // namespace MaterialTexture
+
+typedef std::array<GLTF::Texture *, MaterialTexture::COUNT> MaterialTextures;
+
 class ExportableMaterial {
   public:
     ExportableMaterial();
@@ -50,6 +62,15 @@ class ExportableMaterialBasePBR : public ExportableMaterial {
 
     bool hasTextures() const override;
 
+    // The exported texture of each kind, null when the material doesn't have it
+    MaterialTextures textures() const;
+
+    // Are all factors and modes the same, so the materials only differ by their textures?
+    bool hasSameFactors(const ExportableMaterialBasePBR &other) const;
+
+    // Removes the textures of the given images, e.g. because these failed to load.
+    void removeTextures(const std::set<const GLTF::Image *> &images);
+
   protected:
     Float4 m_glBaseColorFactor;
     Float4 m_glEmissiveFactor;
@@ -62,10 +83,24 @@ class ExportableMaterialBasePBR : public ExportableMaterial {
     GLTF::MaterialPBR::Texture m_glEmissiveTexture;
     GLTF::MaterialPBR::OcclusionTexture m_glOcclusionTexture;
 
+    // Copies the factors and modes of the other material, using the given textures instead of its textures.
+    void copyFrom(const ExportableMaterialBasePBR &other, const MaterialTextures &textures);
+
   private:
     DISALLOW_COPY_MOVE_ASSIGN(ExportableMaterialBasePBR);
 };
 
+// Replaces materials that only differ by their textures, using texture atlases instead.
+class ExportableAtlasMaterial : public ExportableMaterialBasePBR {
+  public:
+    ExportableAtlasMaterial(const std::string &name, const ExportableMaterialBasePBR &prototype,
+                            const MaterialTextures &atlasTextures);
+    ~ExportableAtlasMaterial();
+
+  private:
+    DISALLOW_COPY_MOVE_ASSIGN(ExportableAtlasMaterial);
+};
+
 class ExportableDefaultMaterial : public ExportableMaterialBasePBR {
   public:
     ExportableDefaultMaterial();
@@ -93,8 +128,9 @@ class ExportableMaterialPBR : public ExportableMaterialBasePBR {
                         const MFnDependencyNode &shaderNode);
     MStatus
     tryCreateRoughnessMetalnessTexture(ExportableResources &resources,
-                                      const ExportableTexture* metallicTexture,
-                                      const ExportableTexture* roughnessTexture,
+                                      ExportableTexture* metallicTexture,
+                                      ExportableTexture* roughnessTexture,
+                                      ExportableTexture* occlusionTexture,
                                       MStatus status);
 };
 
@@ -9,8 +9,11 @@
 #include "ExportableScene.h"
 #include "GLTFTargetNames.h"
 #include "MayaException.h"
+#include "MayaUtils.h"
 #include "Mesh.h"
+#include "MeshRenderables.h"
 #include "MeshSkeleton.h"
+#include "ThreadPool.h"
 #include "accessors.h"
 
 ExportableMesh::ExportableMesh(ExportableScene &scene, ExportableNode &node, const MDagPath &shapeDagPath)
@@ -20,23 +23,28 @@ ExportableMesh::ExportableMesh(ExportableScene &scene, ExportableNode &node, con
     auto &resources = scene.resources();
     auto &args = resources.arguments();
 
-    const auto mayaMesh = std::make_unique<Mesh>(scene, shapeDagPath, node);
+    m_mayaMesh = std::make_unique<Mesh>(scene, shapeDagPath, node);
+
+    const auto &mayaMesh = m_mayaMesh;
 
     if (args.dumpMaya) {
         mayaMesh->dump(*args.dumpMaya, shapeDagPath.fullPathName().asChar());
     }
 
+    bool generatesPrimitivesAsync = false;
+
     if (!mayaMesh->isEmpty()) {
         auto shapeName = args.assignName(glMesh, shapeDagPath, "");
 
         auto &mainShape = mayaMesh->shape();
 
-        // Generate primitives
-        MeshRenderables renderables(mayaMesh->allShapes(), args);
+        const auto instanceNumber = mainShape.instanceNumber();
         const auto &shadingMap = mainShape.indices().shadingPerInstance();
-        const auto &shading = shadingMap.at(renderables.instanceNumber);
+        const auto &shading = shadingMap.at(instanceNumber);
         const auto shaderCount = static_cast<int>(shading.shaderGroups.length());
 
+        m_displayName = mainShape.dagPath().partialPathName().asChar();
+
         /* TODO: Implement overrides
         auto mainDagPath = mainShape.dagPath();
         auto mainNode = mainDagPath.node(&status);
@@ -55,78 +63,58 @@ ExportableMesh::ExportableMesh(ExportableScene &scene, ExportableNode &node, con
         overrideShading); THROW_ON_FAILURE(status);
          */
 
-        const auto &vertexBufferEntries = renderables.table();
-        const size_t vertexBufferCount = vertexBufferEntries.size();
-        {
-            size_t vertexBufferIndex = 0;
-            for (auto &&pair : vertexBufferEntries) {
-                const auto &vertexSignature = pair.first;
-                const auto &vertexBuffer = pair.second;
-
-                const int shaderIndex = vertexSignature.shaderIndex;
-                auto &shaderGroup = shaderIndex >= 0 && shaderIndex < shaderCount ? shading.shaderGroups[shaderIndex]
-                                                                                  : MObject::kNullObj;
-
-                ExportableMaterial *material = nullptr;
-
-                // Assign material to primitive
-                if (args.colorizeMaterials) {
-                    const float h = vertexBufferIndex * 1.0f / vertexBufferCount;
-                    const float s = shaderCount == 0 ? 0.5f : 1;
-                    const float v = shaderIndex < 0 ? 0.5f : 1;
-                    material = resources.getDebugMaterial({h, s, v});
-                } else {
-                    material = resources.getMaterial(shaderGroup);
-                    if (!material && resources.arguments().defaultMaterial)
+        MaterialSelector selectMaterial;
+
+        // Assign material to primitive
+        if (args.colorizeMaterials) {
+            // The debug hue depends on the welded vertex buffers, so these primitives are generated right away
+            selectMaterial = [&resources, shaderCount](const ShaderIndex shaderIndex, const float hue) {
+                const float s = shaderCount == 0 ? 0.5f : 1;
+                const float v = shaderIndex < 0 ? 0.5f : 1;
+                return resources.getDebugMaterial({hue, s, v});
+            };
+        } else {
+            // Materials are created from Maya, so resolve these now for all shader indices used by the mesh
+            std::map<ShaderIndex, ExportableMaterial *> materialPerShaderIndex;
+
+            for (auto shaderIndex : shading.primitiveToShaderIndexMap) {
+                if (materialPerShaderIndex.count(shaderIndex) == 0) {
+                    auto &shaderGroup = shaderIndex >= 0 && shaderIndex < shaderCount ? shading.shaderGroups[shaderIndex]
+                                                                                      : MObject::kNullObj;
+
+                    auto *material = resources.getMaterial(shaderGroup);
+                    if (!material && args.defaultMaterial)
                         material = resources.getDefaultMaterial();
-                }
 
-                if (material) {
-                    const auto primitiveName = shapeName + "#" + std::to_string(vertexBufferIndex);
-
-                    auto exportablePrimitive =
-                        std::make_unique<ExportablePrimitive>(primitiveName, vertexBuffer, resources, material);
-                    glMesh.primitives.push_back(&exportablePrimitive->glPrimitive);
-
-                    m_primitives.emplace_back(std::move(exportablePrimitive));
+                    materialPerShaderIndex[shaderIndex] = material;
+                }
+            }
 
-                    if (args.debugTangentVectors) {
-                        auto debugPrimitive = std::make_unique<ExportablePrimitive>(
-                            primitiveName, vertexBuffer, resources, Semantic::Kind::TANGENT, ShapeIndex::main(),
-                            args.debugVectorLength, Color({1, 0, 0, 1}));
-                        glMesh.primitives.push_back(&debugPrimitive->glPrimitive);
-                        m_primitives.emplace_back(move(debugPrimitive));
-                    }
+            selectMaterial = [materialPerShaderIndex](const ShaderIndex shaderIndex, float) {
+                const auto it = materialPerShaderIndex.find(shaderIndex);
+                return it == materialPerShaderIndex.end() ? nullptr : it->second;
+            };
 
-                    if (args.debugNormalVectors) {
-                        auto debugPrimitive = std::make_unique<ExportablePrimitive>(
-                            primitiveName, vertexBuffer, resources, Semantic::Kind::NORMAL, ShapeIndex::main(),
-                            args.debugVectorLength, Color({1, 1, 0, 1}));
-                        glMesh.primitives.push_back(&debugPrimitive->glPrimitive);
-                        m_primitives.emplace_back(move(debugPrimitive));
-                    }
-                }
+            generatesPrimitivesAsync = true;
+        }
 
-                ++vertexBufferIndex;
-            }
-            for (auto &&shape : mayaMesh->allShapes()) {
-                if (shape->shapeIndex.isBlendShapeIndex()) {
-                    m_weightPlugs.emplace_back(shape->weightPlug);
-                    m_initialWeights.emplace_back(shape->initialWeight);
-                    glMesh.weights.emplace_back(shape->initialWeight);
-                    MStringArray weightArrays;
-                    MString weight = shape->weightPlug.name();
-                    weight.split('.', weightArrays);
-
-                    m_morphTargetNames->addName(weightArrays.length() <= 1
-                                                    ? std::string("morph_") + std::to_string(m_morphTargetNames->size())
-                                                    : std::string(weightArrays[1].asChar()));
-                }
-            }
-            if (!mayaMesh->allShapes().empty()) {
-                glMesh.extras.insert({"targetNames", static_cast<GLTF::Object *>(m_morphTargetNames.get())});
+        for (auto &&shape : mayaMesh->allShapes()) {
+            if (shape->shapeIndex.isBlendShapeIndex()) {
+                m_weightPlugs.emplace_back(shape->weightPlug);
+                m_initialWeights.emplace_back(shape->initialWeight);
+                glMesh.weights.emplace_back(shape->initialWeight);
+                MStringArray weightArrays;
+                MString weight = shape->weightPlug.name();
+                weight.split('.', weightArrays);
+
+                m_morphTargetNames->addName(weightArrays.length() <= 1
+                                                ? std::string("morph_") + std::to_string(m_morphTargetNames->size())
+                                                : std::string(weightArrays[1].asChar()));
             }
         }
+        if (!mayaMesh->allShapes().empty()) {
+            glMesh.extras.insert({"targetNames", static_cast<GLTF::Object *>(m_morphTargetNames.get())});
+        }
 
         // Generate skin
         auto &skeleton = mainShape.skeleton();
@@ -183,10 +171,116 @@ ExportableMesh::ExportableMesh(ExportableScene &scene, ExportableNode &node, con
             // '\'') << " as skeleton root for mesh " << quoted(shapeName, '\'')
             // << endl; glSkin.skeleton = &rootJointNode->glPrimaryNode();
         }
+
+        m_keepsVertexBuffers = args.mergeStaticMeshes && skeleton.isEmpty() && m_weightPlugs.empty() &&
+                               !args.debugTangentVectors && !args.debugNormalVectors;
+
+        // Generate primitives.
+        // Welding the vertices doesn't use Maya, so this overlaps with the extraction of the next mesh.
+        // The task must be started last, a failure in this constructor would leave it running on a destroyed mesh.
+        if (generatesPrimitivesAsync) {
+            m_primitivesGenerated = ThreadPool::shared().enqueue(
+                [this, shapeName, instanceNumber, selectMaterial, &resources]() {
+                    generatePrimitives(shapeName, instanceNumber, selectMaterial, resources);
+                });
+        } else {
+            generatePrimitives(shapeName, instanceNumber, selectMaterial, resources);
+        }
+    }
+
+    if (!generatesPrimitivesAsync) {
+        finish();
     }
 }
 
-ExportableMesh::~ExportableMesh() = default;
+ExportableMesh::~ExportableMesh() {
+    // The worker task uses this mesh
+    if (m_primitivesGenerated.valid()) {
+        m_primitivesGenerated.wait();
+    }
+}
+
+void ExportableMesh::generatePrimitives(const std::string &shapeName, const InstanceNumber instanceNumber,
+                                        const MaterialSelector &selectMaterial, ExportableResources &resources) {
+    auto &args = resources.arguments();
+
+    MeshRenderables renderables(m_mayaMesh->allShapes(), instanceNumber, args);
+
+    std::stringstream weldReport;
+    weldReport << "will have " << renderables.maxVertexCount() - renderables.weldCount() << " vertices. Welded#"
+               << renderables.weldCount() << ", min#" << renderables.minVertexCount() << ", max#"
+               << renderables.maxVertexCount();
+    m_weldReport = weldReport.str();
+
+    const auto &vertexBufferEntries = renderables.table();
+    const size_t vertexBufferCount = vertexBufferEntries.size();
+
+    size_t vertexBufferIndex = 0;
+    for (auto &&pair : vertexBufferEntries) {
+        const auto &vertexSignature = pair.first;
+        const auto &vertexBuffer = pair.second;
+
+        const float hue = vertexBufferIndex * 1.0f / vertexBufferCount;
+
+        auto *material = selectMaterial(vertexSignature.shaderIndex, hue);
+
+        if (material) {
+            const auto primitiveName = shapeName + "#" + std::to_string(vertexBufferIndex);
+
+            auto exportablePrimitive = std::make_unique<ExportablePrimitive>(primitiveName, vertexBuffer, resources, material);
+            glMesh.primitives.push_back(&exportablePrimitive->glPrimitive);
+
+            m_primitives.emplace_back(std::move(exportablePrimitive));
+
+            if (m_keepsVertexBuffers) {
+                MaterialVertexBuffer kept{material};
+                kept.vertexBuffer.indices = vertexBuffer.indices;
+                kept.vertexBuffer.componentsMap = vertexBuffer.componentsMap;
+                kept.vertexBuffer.vertexCount = vertexBuffer.maxIndex();
+                m_vertexBuffers.emplace_back(std::move(kept));
+            }
+
+            if (args.debugTangentVectors) {
+                auto debugPrimitive =
+                    std::make_unique<ExportablePrimitive>(primitiveName, vertexBuffer, resources, Semantic::Kind::TANGENT,
+                                                          ShapeIndex::main(), args.debugVectorLength, Color({1, 0, 0, 1}));
+                glMesh.primitives.push_back(&debugPrimitive->glPrimitive);
+                m_primitives.emplace_back(move(debugPrimitive));
+            }
+
+            if (args.debugNormalVectors) {
+                auto debugPrimitive =
+                    std::make_unique<ExportablePrimitive>(primitiveName, vertexBuffer, resources, Semantic::Kind::NORMAL,
+                                                          ShapeIndex::main(), args.debugVectorLength, Color({1, 1, 0, 1}));
+                glMesh.primitives.push_back(&debugPrimitive->glPrimitive);
+                m_primitives.emplace_back(move(debugPrimitive));
+            }
+        }
+
+        ++vertexBufferIndex;
+    }
+}
+
+void ExportableMesh::finish() {
+    if (m_primitivesGenerated.valid()) {
+        m_primitivesGenerated.get();
+    }
+
+    if (!m_weldReport.empty()) {
+        cout << prefix << m_displayName << " " << m_weldReport << endl;
+        m_weldReport.clear();
+    }
+
+    // This deletes the temporary Maya nodes, so it must happen on the main thread
+    m_mayaMesh.reset();
+}
+
+std::vector<MaterialVertexBuffer> ExportableMesh::detachVertexBuffers() {
+    glMesh.primitives.clear();
+    m_primitives.clear();
+    m_keepsVertexBuffers = false;
+    return std::move(m_vertexBuffers);
+}
 
 void ExportableMesh::getAllAccessors(std::vector<GLTF::Accessor *> &accessors) const {
     for (auto &&primitive : m_primitives) {
@@ -219,6 +313,10 @@ void ExportableMesh::attachToNode(GLTF::Node &node) {
     }
 }
 
+bool ExportableMesh::hasTimeDependentWeights() const {
+    return std::any_of(m_weightPlugs.begin(), m_weightPlugs.end(), utils::isTimeDependent);
+}
+
 void ExportableMesh::updateWeights() {
     for (size_t i = 0; i < m_weightPlugs.size(); ++i) {
         auto &plug = m_weightPlugs.at(i);
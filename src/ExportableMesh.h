@@ -2,12 +2,22 @@
 
 #include "ExportableObject.h"
 #include "BasicTypes.h"
+#include "MeshRenderables.h"
+#include "sceneTypes.h"
 
 class ExportableResources;
 class ExportablePrimitive;
 class Arguments;
 class ExportableScene;
 class ExportableNode;
+class ExportableMaterial;
+class Mesh;
+
+// A vertex buffer of a mesh, with the material of its primitive
+struct MaterialVertexBuffer {
+    ExportableMaterial *material;
+    VertexBuffer vertexBuffer;
+};
 
 class ExportableMesh : public ExportableObject {
   public:
@@ -28,19 +38,48 @@ class ExportableMesh : public ExportableObject {
 
     std::vector<float> currentWeights() const;
 
+    // Can any of the blend shape weights change over time?
+    bool hasTimeDependentWeights() const;
+
     void attachToNode(GLTF::Node &node);
 
     void updateWeights();
 
     void getAllAccessors(std::vector<GLTF::Accessor *> &accessors) const;
 
+    // Are the vertex buffers kept, so these can be merged with other static meshes?
+    // Only meshes without skin and blend shapes are kept, when merging static meshes.
+    bool isMergeable() const { return m_keepsVertexBuffers; }
+
+    // Moves the kept vertex buffers out of this mesh, and removes its primitives.
+    std::vector<MaterialVertexBuffer> detachVertexBuffers();
+
+    // Waits until the primitives are generated, and releases the extracted Maya mesh.
+    // Rethrows the exception of the worker thread, if any. Must be called on the main thread.
+    void finish();
+
   private:
     DISALLOW_COPY_MOVE_ASSIGN(ExportableMesh);
 
+    // Gets the material of the primitives with the given shader index, and debugging hue
+    typedef std::function<ExportableMaterial *(ShaderIndex shaderIndex, float hue)> MaterialSelector;
+
+    // Welds the vertices and creates the primitives. Doesn't use Maya, so this can run on a worker thread.
+    void generatePrimitives(const std::string &shapeName, InstanceNumber instanceNumber,
+                            const MaterialSelector &selectMaterial, ExportableResources &resources);
+
+    std::unique_ptr<Mesh> m_mayaMesh;
+    std::future<void> m_primitivesGenerated;
+    std::string m_displayName;
+    std::string m_weldReport;
+
     std::vector<float> m_initialWeights;
     std::vector<MPlug> m_weightPlugs;
     std::vector<std::unique_ptr<ExportablePrimitive>> m_primitives;
 
+    bool m_keepsVertexBuffers = false;
+    std::vector<MaterialVertexBuffer> m_vertexBuffers;
+
     std::vector<Float4x4> m_inverseBindMatrices;
     std::unique_ptr<GLTF::Accessor> m_inverseBindMatricesAccessor;
     std::unique_ptr<GLTF::MorphTargetNames> m_morphTargetNames =
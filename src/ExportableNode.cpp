@@ -171,6 +171,27 @@ void ExportableNode::updateNodeTransforms(NodeTransformCache &transformCache) {
     }
 }
 
+MMatrix ExportableNode::glWorldMatrix() const {
+    const auto localMatrix = glLocalMatrix();
+    return parentNode ? localMatrix * parentNode->glWorldMatrix() : localMatrix;
+}
+
+MMatrix ExportableNode::glLocalMatrix() const {
+    // The mesh is attached to the primary node, which is a child of the secondary node
+    const auto primaryMatrix = toMatrix(static_cast<const GLTF::Node::TransformTRS &>(*glPrimaryNode().transform));
+    return transformKind != TransformKind::Simple ? primaryMatrix * glSecondaryMatrix() : primaryMatrix;
+}
+
+MMatrix ExportableNode::glSecondaryMatrix() const {
+    return toMatrix(static_cast<const GLTF::Node::TransformTRS &>(*glSecondaryNode().transform));
+}
+
+void ExportableNode::setSecondaryMatrix(const MMatrix &matrix) {
+    // The transform points into the initial or current transform state of this node
+    auto &trs = static_cast<GLTF::Node::TransformTRS &>(*glSecondaryNode().transform);
+    toTRS(matrix, trs, posPrecision, sclPrecision, dirPrecision);
+}
+
 bool ExportableNode::tryMergeRedundantShapeNode() {
     if (!this->hasAttachedShape())
         return false;
@@ -43,6 +43,23 @@ class ExportableNode : public ExportableObject {
     // nullptr for root nodes.
     ExportableNode *parentNode = nullptr;
 
+    // True when neither the local transforms nor the blend shape weights can change over time.
+    // See ExportableScene::detectStaticNodes
+    bool isStatic = false;
+
+    // The matrix of the exported GLTF nodes, from the mesh vertices to the world, excluding the root scaling node.
+    MMatrix glWorldMatrix() const;
+
+    // The matrix of the exported GLTF nodes, from the mesh vertices to the GLTF parent node.
+    MMatrix glLocalMatrix() const;
+
+    // The matrix of the secondary GLTF node, the one that is a child of the GLTF parent node.
+    MMatrix glSecondaryMatrix() const;
+
+    // Replaces the transform of the secondary GLTF node by the decomposition of the matrix, which must not be skewed.
+    // See ExportableScene::flattenStaticHierarchy
+    void setSecondaryMatrix(const MMatrix &matrix);
+
     NodeTransformState initialTransformState;
     NodeTransformState currentTransformState;
 
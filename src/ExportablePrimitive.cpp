@@ -125,6 +125,21 @@ ExportablePrimitive::ExportablePrimitive(const std::string &name,
                     accessorName = ss.str();
                 }
 
+                if (vertexBuffer.zeroDeltaSlots.count(slot)) {
+                    // glTF requires all targets in all primitives, so share a
+                    // single accessor without data for all zero deltas
+                    const auto dimension = slot.dimension();
+                    auto &zeroAccessor = glZeroDeltaAccessors[dimension];
+                    if (!zeroAccessor) {
+                        zeroAccessor = std::make_unique<ZeroAccessor>(
+                            args.makeName(name + "/zeroDeltas"),
+                            glAccessorType(dimension),
+                            static_cast<int>(vertexBuffer.maxIndex()));
+                    }
+                    glAttributes[attributeSlot] = zeroAccessor.get();
+                    continue;
+                }
+
                 auto accessor = contiguousElementAccessor(
                     accessorName, slot.semantic, slot.shapeIndex, pair.second);
                 glAttributes[attributeSlot] = accessor.get();
@@ -211,4 +226,8 @@ void ExportablePrimitive::getAllAccessors(
     for (auto &&accessor : glAccessors) {
         accessors.emplace_back(accessor.get());
     }
+
+    for (auto &&pair : glZeroDeltaAccessors) {
+        accessors.emplace_back(pair.second.get());
+    }
 }
@@ -35,5 +35,9 @@ class ExportablePrimitive {
   private:
     std::vector<std::unique_ptr<GLTF::Accessor>> glAccessors;
 
+    // The shared accessors of the blend shape targets that don't move this
+    // primitive, per dimension
+    std::map<size_t, std::unique_ptr<GLTF::Accessor>> glZeroDeltaAccessors;
+
     DISALLOW_COPY_MOVE_ASSIGN(ExportablePrimitive);
 };
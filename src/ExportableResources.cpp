@@ -5,12 +5,27 @@
 #include "ExportableMaterial.h"
 #include "ExportableResources.h"
 #include "MayaException.h"
+#include "ThreadPool.h"
+#include "atlasLayout.h"
+#include "contentHash.h"
 #include "filesystem.h"
+#include "kernels.h"
+#include "process.h"
 
 ExportableResources::ExportableResources(const Arguments &args)
     : m_args(args) {}
 
-ExportableResources::~ExportableResources() {}
+ExportableResources::~ExportableResources() {
+    // The loading and packing tasks write into the images, so these must complete first.
+    for (auto &pair : m_imageFiles) {
+        if (pair.second->loaded.valid()) {
+            pair.second->loaded.wait();
+        }
+        if (pair.second->packed.valid()) {
+            pair.second->packed.wait();
+        }
+    }
+}
 
 ExportableMaterial *
 ExportableResources::getMaterial(const MObject &shaderGroup) {
@@ -43,7 +58,16 @@ ExportableResources::getMaterial(const MObject &shaderGroup) {
     return materialPtr.get();
 }
 
-GLTF::Image *ExportableResources::getImage(fs::path path) {
+// Loads the image file on a worker thread, and moves its data into the image.
+// An image can be loaded again, e.g. after resizing it, then the loaded image takes and frees the previous data.
+static void loadImageData(GLTF::Image *image, const std::string &path) {
+    const std::unique_ptr<GLTF::Image> loaded(GLTF::Image::load(path));
+    image->mimeType = loaded->mimeType;
+    image->byteLength = loaded->byteLength;
+    std::swap(image->data, loaded->data);
+}
+
+GLTF::Image *ExportableResources::getImage(fs::path path, const bool hasColorData, const int maxSize) {
     if (!exists(path)) {
         MayaException::printError(
             formatted("Image with path '%s' does not exist!", path.c_str()));
@@ -52,10 +76,23 @@ GLTF::Image *ExportableResources::getImage(fs::path path) {
         return nullptr;
     }
 
-    std::string key(path.generic_string());
+    // Different relative paths or symbolic links to the same file share the image.
+    std::error_code error;
+    const auto canonicalPath = canonical(path, error);
+
+    std::string key((error ? path : canonicalPath).generic_string());
     std::transform(key.begin(), key.end(), key.begin(), ::tolower);
     auto &imagePtr = m_imageMap[key];
-    if (!imagePtr) {
+    if (imagePtr) {
+        // An image that is also used for non-color data must be encoded as such.
+        auto &imageFile = *m_imageFiles.at(imagePtr.get());
+        imageFile.hasColorData &= hasColorData;
+
+        // The smallest size budget wins.
+        if (maxSize > 0 && (imageFile.maxSize == 0 || maxSize < imageFile.maxSize)) {
+            imageFile.maxSize = maxSize;
+        }
+    } else {
         if (m_args.convertUnsupportedImages) {
             // Convert unsupported formats to PNG
             std::string ext = path.extension().generic_string();
@@ -63,32 +100,966 @@ GLTF::Image *ExportableResources::getImage(fs::path path) {
 
             if (ext != ".jpg" && ext != ".jpeg" && ext != ".png" &&
                 ext != ".dds") {
-                std::cout << prefix << "WARNING: Converting image '" << path
-                          << "' to .png, since glTF does not support " << ext
-                          << std::endl;
+                path = convertImage(path);
+            }
+        }
+
+        auto &imageFile = addImage(imagePtr, path, hasColorData, maxSize);
+        imageFile.metadata = ImageMetadata::probe(path);
+
+        // Images that are too large are loaded after downscaling these.
+        if (!imageFile.needsResize()) {
+            startLoading(imagePtr.get(), imageFile);
+        }
+    }
+    return imagePtr.get();
+}
+
+ExportableResources::ImageFile &ExportableResources::addImage(std::unique_ptr<GLTF::Image> &imagePtr, const fs::path &path,
+                                                              const bool hasColorData, const int maxSize) {
+    std::string ext = path.extension().generic_string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+
+    imagePtr = std::make_unique<GLTF::Image>(path.filename().generic_string());
+    if (ext == ".png") {
+        imagePtr->mimeType = "image/png";
+    } else if (ext == ".jpg" || ext == ".jpeg") {
+        imagePtr->mimeType = "image/jpeg";
+    }
+
+    const auto image = imagePtr.get();
+    m_discoveredImages.push_back(image);
+
+    auto &imageFile = m_imageFiles[image];
+    imageFile = std::make_unique<ImageFile>();
+    imageFile->path = path;
+    imageFile->hasColorData = hasColorData;
+    imageFile->maxSize = maxSize;
+    return *imageFile;
+}
+
+// The contents hash of a source image, remembered in the cache folder by path, size and modification time,
+// so unchanged images are not read again.
+static uint64_t getSourceImageHash(const fs::path &cacheFolder, const fs::path &sourcePath, uint64_t *byteCount = nullptr) {
+    return ContentHash::ofIndexedFile(cacheFolder / "index", sourcePath, byteCount);
+}
+
+fs::path ExportableResources::imageHashIndexFolder() const { return imageCacheFolder() / "index"; }
+
+void ExportableResources::startLoading(GLTF::Image *image, ImageFile &imageFile) const {
+    const auto imagePath = imageFile.path.generic_string();
+    const auto file = &imageFile;
+
+    // Only embedded images need their data, external images are just hashed, and copied when saving.
+    // Their hashes come from the index, so unchanged external images are never read.
+    // KTX2 images are loaded after encoding.
+    if (m_args.glb && !m_args.externalTextures && !m_args.ktx2Textures) {
+        file->loaded = ThreadPool::shared().enqueue([image, imagePath, file]() {
+            loadImageData(image, imagePath);
+            file->contentHash = ContentHash::of(image->data, image->byteLength);
+            file->byteCount = image->byteLength;
+        });
+    } else {
+        file->loaded = ThreadPool::shared().enqueue(
+            [cacheFolder = imageCacheFolder(), imagePath, file]() { file->contentHash = getSourceImageHash(cacheFolder, imagePath, &file->byteCount); });
+    }
+}
+
+fs::path ExportableResources::imageCacheFolder() const {
+    return m_args.imageCacheFolder.length() > 0 ? fs::path(m_args.imageCacheFolder.asChar())
+                                                : fs::temp_directory_path() / "Maya2glTF" / "images";
+}
+
+fs::path ExportableResources::convertImage(const fs::path &sourcePath) const {
+    const auto cacheFolder = imageCacheFolder();
+
+    // Keep the filename, it becomes the URI of the image.
+    const auto sourceHash = getSourceImageHash(cacheFolder, sourcePath);
+    const auto convertedPath = cacheFolder / ContentHash::hex(sourceHash) / sourcePath.filename().replace_extension(".png");
+
+    if (exists(convertedPath)) {
+        cout << prefix << "Reusing image '" << convertedPath << "' converted from '" << sourcePath << "'" << endl;
+        return convertedPath;
+    }
+
+    cout << prefix << "WARNING: Converting image '" << sourcePath << "' to .png, since glTF does not support "
+         << sourcePath.extension() << endl;
+
+    MImage image;
+    THROW_ON_FAILURE_WITH(image.readFromFile(MString(sourcePath.c_str())), formatted("Failed to read image %s", sourcePath.c_str()));
+
+    // Write to a temporary file first, so an interrupted export never leaves a truncated image in the cache.
+    create_directories(convertedPath.parent_path());
+    auto partialPath = convertedPath;
+    partialPath += ".partial";
+
+    THROW_ON_FAILURE_WITH(image.writeToFile(MString(partialPath.c_str()), "png"),
+                          formatted("Failed to write image %s", partialPath.c_str()));
+
+    rename(partialPath, convertedPath);
+    return convertedPath;
+}
+
+GLTF::Image *ExportableResources::getPackedImage(const fs::path &occlusionPath, const fs::path &roughnessPath,
+                                                 const fs::path &metallicPath, const int maxSize) {
+    const std::array<fs::path, 3> sourcePaths = {occlusionPath, roughnessPath, metallicPath};
+    for (const auto &sourcePath : sourcePaths) {
+        if (!sourcePath.empty() && !exists(sourcePath)) {
+            MayaException::printError(formatted("Image with path '%s' does not exist!", sourcePath.c_str()));
+            return nullptr;
+        }
+    }
+
+    const auto cacheFolder = imageCacheFolder();
+
+    // The packed image is cached by the contents of its source images.
+    ContentHash hash;
+    for (const auto &sourcePath : sourcePaths) {
+        const uint64_t sourceHash = sourcePath.empty() ? 0 : getSourceImageHash(cacheFolder, sourcePath);
+        hash.append(&sourceHash, sizeof(sourceHash));
+    }
+
+    // Data maps are always packed losslessly.
+    std::string filename = roughnessPath.stem().generic_string() + "-" + metallicPath.stem().generic_string() + ".png";
+    if (!occlusionPath.empty()) {
+        filename = occlusionPath.stem().generic_string() + "-" + filename;
+    }
+
+    const auto packedPath = cacheFolder / "packed" / ContentHash::hex(hash.value()) / filename;
+
+    if (exists(packedPath)) {
+        cout << prefix << "Reusing packed image '" << packedPath << "'" << endl;
+        return getImage(packedPath, false, maxSize);
+    }
+
+    // Another material might already pack the same images in this export.
+    std::string key(packedPath.generic_string());
+    std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+    auto &imagePtr = m_imageMap[key];
+    if (imagePtr) {
+        auto &imageFile = *m_imageFiles.at(imagePtr.get());
+        if (maxSize > 0 && (imageFile.maxSize == 0 || maxSize < imageFile.maxSize)) {
+            imageFile.maxSize = maxSize;
+        }
+        return imagePtr.get();
+    }
+
+    struct Source {
+        std::vector<uint8_t> pixels;
+        size_t width = 0;
+        size_t height = 0;
+    };
+
+    // Shared with the packing task, which must be copyable.
+    const auto sources = std::make_shared<std::array<Source, 3>>();
+
+    // Read the source images. MImage is part of the Maya API, so this can't run in parallel.
+    size_t width = SIZE_MAX;
+    size_t height = SIZE_MAX;
+    for (size_t index = 0; index < sourcePaths.size(); ++index) {
+        const auto &sourcePath = sourcePaths[index];
+        if (sourcePath.empty())
+            continue;
+
+        MImage mayaImage;
+        unsigned sourceWidth = 0;
+        unsigned sourceHeight = 0;
+        if (!mayaImage.readFromFile(MString(sourcePath.c_str())) || !mayaImage.getSize(sourceWidth, sourceHeight) ||
+            mayaImage.depth() != 4) {
+            MayaException::printError(formatted("Failed to read image '%s', not packing it", sourcePath.c_str()));
+            m_imageMap.erase(key);
+            return nullptr;
+        }
+
+        auto &source = (*sources)[index];
+        source.width = sourceWidth;
+        source.height = sourceHeight;
+        source.pixels.assign(mayaImage.pixels(), mayaImage.pixels() + source.width * source.height * 4);
+
+        // Images with different sizes are downscaled to the smallest one.
+        width = std::min(width, source.width);
+        height = std::min(height, source.height);
+    }
+
+    auto &imageFile = addImage(imagePtr, packedPath, false, maxSize);
+    imageFile.metadata.width = static_cast<int>(width);
+    imageFile.metadata.height = static_cast<int>(height);
+
+    cout << prefix << "Packing " << (occlusionPath.empty() ? "" : "occlusion, ") << "roughness and metallic images into '" << packedPath
+         << "'" << endl;
+
+    const auto file = &imageFile;
+    file->packed = ThreadPool::shared().enqueue([sources, width, height, file]() {
+        for (auto &source : *sources) {
+            if (source.pixels.empty() || (source.width == width && source.height == height))
+                continue;
+
+            std::vector<uint8_t> pixels(width * height * 4);
+            kernels::downsampleRGBA8(source.pixels.data(), source.width, source.height, pixels.data(), width, height, false);
+            source.pixels = std::move(pixels);
+        }
+
+        const auto &occlusion = (*sources)[0].pixels;
+        file->packedPixels.resize(width * height * 4);
+        kernels::packORM(occlusion.empty() ? nullptr : occlusion.data(), (*sources)[1].pixels.data(), (*sources)[2].pixels.data(),
+                         file->packedPixels.data(), width * height);
+    });
 
-                MImage image;
-                THROW_ON_FAILURE_WITH(
-                    image.readFromFile(MString(path.c_str())),
-                    formatted("Failed to read image %s", path.c_str()));
+    return imagePtr.get();
+}
+
+void ExportableResources::writePackedImages() {
+    for (const auto image : m_discoveredImages) {
+        auto &imageFile = *m_imageFiles.at(image);
+        if (!imageFile.packed.valid())
+            continue;
+
+        imageFile.packed.get();
+
+        MImage mayaImage;
+        THROW_ON_FAILURE(mayaImage.setPixels(imageFile.packedPixels.data(), static_cast<unsigned>(imageFile.metadata.width),
+                                             static_cast<unsigned>(imageFile.metadata.height)));
+        imageFile.packedPixels = {};
+
+        create_directories(imageFile.path.parent_path());
+        auto partialPath = imageFile.path;
+        partialPath += ".partial";
+
+        THROW_ON_FAILURE_WITH(mayaImage.writeToFile(MString(partialPath.c_str()), "png"),
+                              formatted("Failed to write image %s", partialPath.c_str()));
+
+        rename(partialPath, imageFile.path);
+
+        // Images that are too large are loaded after downscaling these.
+        if (!imageFile.needsResize()) {
+            startLoading(image, imageFile);
+        }
+    }
+}
+
+void ExportableResources::resizeImages() {
+    std::vector<GLTF::Image *> images;
+    for (const auto image : m_discoveredImages) {
+        if (m_imageFiles.at(image)->needsResize()) {
+            images.push_back(image);
+        }
+    }
+
+    if (images.empty())
+        return;
+
+    const auto cacheFolder = imageCacheFolder();
+
+    struct Resize {
+        fs::path targetPath;
+        std::vector<uint8_t> sourcePixels;
+        std::vector<uint8_t> targetPixels;
+        size_t sourceWidth = 0;
+        size_t sourceHeight = 0;
+        size_t targetWidth = 0;
+        size_t targetHeight = 0;
+    };
+
+    std::vector<Resize> resizes(images.size());
+
+    // Read the images that are not cached yet. MImage is part of the Maya API, so this can't run in parallel.
+    for (size_t index = 0; index < images.size(); ++index) {
+        auto &imageFile = *m_imageFiles.at(images[index]);
+        auto &resize = resizes[index];
+
+        // A smaller size budget might have been found after the loading started.
+        if (imageFile.loaded.valid()) {
+            imageFile.loaded.wait();
+        }
+
+        std::string ext = imageFile.path.extension().generic_string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        const auto targetExt = ext == ".jpg" || ext == ".jpeg" ? ext : ".png";
+
+        const auto sourceHash = getSourceImageHash(cacheFolder, imageFile.path);
+        const auto folderName = ContentHash::hex(sourceHash) + "-" + std::to_string(imageFile.maxSize);
+        resize.targetPath = cacheFolder / "resized" / folderName / imageFile.path.filename().replace_extension(targetExt);
+
+        if (exists(resize.targetPath))
+            continue;
+
+        MImage mayaImage;
+        unsigned width = 0;
+        unsigned height = 0;
+        if (!mayaImage.readFromFile(MString(imageFile.path.c_str())) || !mayaImage.getSize(width, height) || mayaImage.depth() != 4) {
+            MayaException::printError(formatted("Failed to read image '%s', exporting it at its full size", imageFile.path.c_str()));
+            resize.targetPath.clear();
+            continue;
+        }
+
+        const auto scale = static_cast<double>(imageFile.maxSize) / std::max(width, height);
+        resize.sourceWidth = width;
+        resize.sourceHeight = height;
+        resize.targetWidth = std::max(1L, std::lround(width * scale));
+        resize.targetHeight = std::max(1L, std::lround(height * scale));
+        resize.sourcePixels.assign(mayaImage.pixels(), mayaImage.pixels() + resize.sourceWidth * resize.sourceHeight * 4);
+    }
+
+    ThreadPool::shared().parallelFor(resizes.size(), [&](const size_t index) {
+        auto &resize = resizes[index];
+        if (resize.sourcePixels.empty())
+            return;
+
+        resize.targetPixels.resize(resize.targetWidth * resize.targetHeight * 4);
+        kernels::downsampleRGBA8(resize.sourcePixels.data(), resize.sourceWidth, resize.sourceHeight, resize.targetPixels.data(),
+                                 resize.targetWidth, resize.targetHeight, m_imageFiles.at(images[index])->hasColorData);
+        resize.sourcePixels = {};
+    });
+
+    // Write the downscaled images, also on the main thread.
+    for (size_t index = 0; index < images.size(); ++index) {
+        const auto image = images[index];
+        auto &imageFile = *m_imageFiles.at(image);
+        auto &resize = resizes[index];
+
+        if (!resize.targetPixels.empty()) {
+            MImage mayaImage;
+            THROW_ON_FAILURE(mayaImage.setPixels(resize.targetPixels.data(), static_cast<unsigned>(resize.targetWidth),
+                                                 static_cast<unsigned>(resize.targetHeight)));
+
+            create_directories(resize.targetPath.parent_path());
+            auto partialPath = resize.targetPath;
+            partialPath += ".partial";
+
+            const auto format = resize.targetPath.extension() == ".png" ? "png" : "jpg";
+            THROW_ON_FAILURE_WITH(mayaImage.writeToFile(MString(partialPath.c_str()), format),
+                                  formatted("Failed to write image %s", partialPath.c_str()));
+
+            rename(partialPath, resize.targetPath);
+
+            cout << prefix << "Downscaled image '" << imageFile.path << "' from " << resize.sourceWidth << "x" << resize.sourceHeight
+                 << " to " << resize.targetWidth << "x" << resize.targetHeight << endl;
+        }
 
-                path = fs::temp_directory_path() /
-                       path.filename().replace_extension(".png");
+        if (!resize.targetPath.empty()) {
+            // The alpha channel is kept, even though Maya writes all PNG images with alpha.
+            const auto metadata = ImageMetadata::probe(resize.targetPath);
+            imageFile.metadata.width = metadata.width;
+            imageFile.metadata.height = metadata.height;
+            imageFile.path = resize.targetPath;
 
-                THROW_ON_FAILURE_WITH(
-                    image.writeToFile(MString(path.c_str()), "png"),
-                    formatted("Failed to write image %s", path.c_str()));
+            image->uri = resize.targetPath.filename().generic_string();
+            if (resize.targetPath.extension() == ".png") {
+                image->mimeType = "image/png";
             }
         }
 
+        startLoading(image, imageFile);
+    }
+}
+
+// Are all texture coordinates of the primitive within [0,1], so these can address a tile of an atlas?
+// Morph targets that move the texture coordinates are not supported.
+static bool hasAtlasableTexCoords(GLTF::Primitive *primitive) {
+    const auto attribute = primitive->attributes.find("TEXCOORD_0");
+    if (attribute == primitive->attributes.end())
+        return false;
+
+    for (const auto target : primitive->targets) {
+        if (target->attributes.count("TEXCOORD_0"))
+            return false;
+    }
+
+    // Allow for rounding errors at the edges
+    const float tolerance = 1e-4f;
+
+    const auto accessor = attribute->second;
+    float uv[2];
+    for (int index = 0; index < accessor->count; ++index) {
+        accessor->getComponentAtIndex(index, uv);
+        if (uv[0] < -tolerance || uv[0] > 1 + tolerance || uv[1] < -tolerance || uv[1] > 1 + tolerance)
+            return false;
+    }
+    return true;
+}
+
+void ExportableResources::atlasTextures(const std::vector<GLTF::Primitive *> &primitives) {
+    const auto maxAtlasSize = m_args.textureAtlasSize & ~3;
+    const auto maxTileSize = maxAtlasSize / 4;
+
+    // The tiles get a border of repeated edge pixels, so bilinear filtering and the first mipmaps don't bleed.
+    const int padding = 2;
+
+    // Packed images are atlased too, so these must be written first.
+    writePackedImages();
+
+    std::map<const GLTF::Material *, ExportableMaterialBasePBR *> materialPerGlMaterial;
+    for (auto &pair : m_materialMap) {
+        const auto material = dynamic_cast<ExportableMaterialBasePBR *>(pair.second.get());
+        if (material) {
+            materialPerGlMaterial[material->glMaterial()] = material;
+        }
+    }
+
+    struct Candidate {
+        ExportableMaterialBasePBR *material = nullptr;
+        MaterialTextures textures{};
+        int width = 0;
+        int height = 0;
+        bool isAtlasable = true;
+        std::vector<GLTF::Primitive *> primitives;
+    };
+
+    // The candidate materials, in the order of the primitives, so the atlases are the same in each export.
+    std::vector<Candidate> candidates;
+    std::map<const GLTF::Material *, size_t> candidateIndices;
+
+    for (const auto primitive : primitives) {
+        const auto found = materialPerGlMaterial.find(primitive->material);
+        if (found == materialPerGlMaterial.end())
+            continue;
+
+        const auto inserted = candidateIndices.emplace(primitive->material, candidates.size());
+        if (inserted.second) {
+            Candidate candidate;
+            candidate.material = found->second;
+            candidate.textures = candidate.material->textures();
+            candidate.isAtlasable = false;
+
+            // All textures of the material must be small, and have the same size, so they share their tiles.
+            for (const auto texture : candidate.textures) {
+                if (!texture)
+                    continue;
+
+                const auto &imageFile = *m_imageFiles.at(texture->source);
+                const auto &metadata = imageFile.metadata;
+                const auto isFirst = candidate.width == 0;
+                candidate.isAtlasable = (isFirst || (candidate.isAtlasable && metadata.width == candidate.width &&
+                                                     metadata.height == candidate.height)) &&
+                                        metadata.width > 0 && metadata.height > 0 && metadata.width <= maxTileSize &&
+                                        metadata.height <= maxTileSize && !imageFile.needsResize();
+                candidate.width = metadata.width;
+                candidate.height = metadata.height;
+
+                if (!candidate.isAtlasable)
+                    break;
+            }
+
+            candidates.emplace_back(std::move(candidate));
+        }
+
+        auto &candidate = candidates[inserted.first->second];
+        candidate.isAtlasable = candidate.isAtlasable && hasAtlasableTexCoords(primitive);
+        candidate.primitives.push_back(primitive);
+    }
+
+    // Group the materials that can be merged: the same factors, the same kinds of textures, and the same samplers.
+    std::vector<std::vector<size_t>> groups;
+    for (size_t index = 0; index < candidates.size(); ++index) {
+        const auto &candidate = candidates[index];
+        if (!candidate.isAtlasable)
+            continue;
+
+        const auto canMerge = [&](const std::vector<size_t> &group) {
+            const auto &other = candidates[group.front()];
+            for (size_t kind = 0; kind < MaterialTexture::COUNT; ++kind) {
+                const auto texture = candidate.textures[kind];
+                const auto otherTexture = other.textures[kind];
+                if ((texture == nullptr) != (otherTexture == nullptr) || (texture && texture->sampler != otherTexture->sampler))
+                    return false;
+            }
+
+            // A packed occlusion texture must stay packed
+            const auto sharesORM = [](const MaterialTextures &textures) {
+                return textures[MaterialTexture::OCCLUSION] == textures[MaterialTexture::METALLIC_ROUGHNESS];
+            };
+            return sharesORM(candidate.textures) == sharesORM(other.textures) && candidate.material->hasSameFactors(*other.material);
+        };
+
+        const auto group = std::find_if(groups.begin(), groups.end(), canMerge);
+        if (group == groups.end()) {
+            groups.push_back({index});
+        } else {
+            group->push_back(index);
+        }
+    }
+
+    const auto cacheFolder = imageCacheFolder();
+
+    struct Atlas {
+        std::vector<size_t> members;
+        std::vector<AtlasTile> tiles;
+        int width = 0;
+        int height = 0;
+        std::array<fs::path, MaterialTexture::COUNT> paths;
+    };
+
+    std::vector<Atlas> atlases;
+
+    for (const auto &group : groups) {
+        if (group.size() < 2)
+            continue;
+
+        std::vector<std::pair<int, int>> tileSizes;
+        for (const auto index : group) {
+            tileSizes.emplace_back(candidates[index].width + 2 * padding, candidates[index].height + 2 * padding);
+        }
+
+        const AtlasLayout layout(tileSizes, maxAtlasSize);
+        const auto firstAtlasIndex = atlases.size();
+        for (const auto &size : layout.atlasSizes()) {
+            Atlas atlas;
+            atlas.width = size.first;
+            atlas.height = size.second;
+            atlases.emplace_back(std::move(atlas));
+        }
+
+        for (size_t tileIndex = 0; tileIndex < group.size(); ++tileIndex) {
+            const auto &tile = layout.tiles()[tileIndex];
+            auto &atlas = atlases[firstAtlasIndex + tile.atlasIndex];
+            atlas.members.push_back(group[tileIndex]);
+            atlas.tiles.push_back(tile);
+        }
+    }
+
+    // An atlas with a single tile doesn't save anything
+    atlases.erase(std::remove_if(atlases.begin(), atlases.end(), [](const Atlas &atlas) { return atlas.members.size() < 2; }),
+                  atlases.end());
+
+    struct Composition {
+        const Atlas *atlas;
+        MaterialTexture::Kind kind;
+        std::vector<std::vector<uint8_t>> sourcePixels;
+        std::vector<uint8_t> atlasPixels;
+    };
+
+    std::vector<Composition> compositions;
+
+    for (size_t atlasIndex = 0; atlasIndex < atlases.size(); ++atlasIndex) {
+        auto &atlas = atlases[atlasIndex];
+        const auto &first = candidates[atlas.members.front()];
+
+        for (size_t kind = 0; kind < MaterialTexture::COUNT; ++kind) {
+            if (!first.textures[kind] || (kind == MaterialTexture::OCCLUSION && first.textures[kind] == first.textures[MaterialTexture::METALLIC_ROUGHNESS]))
+                continue;
+
+            // The atlas is cached by the contents of its source images and its layout.
+            ContentHash hash;
+            const int dimensions[] = {atlas.width, atlas.height, padding};
+            hash.append(dimensions, sizeof(dimensions));
+            for (size_t memberIndex = 0; memberIndex < atlas.members.size(); ++memberIndex) {
+                const auto &tile = atlas.tiles[memberIndex];
+                const auto sourceHash =
+                    getSourceImageHash(cacheFolder, getImagePath(candidates[atlas.members[memberIndex]].textures[kind]->source));
+                const int position[] = {tile.x, tile.y};
+                hash.append(&sourceHash, sizeof(sourceHash));
+                hash.append(position, sizeof(position));
+            }
+
+            // The filename becomes the URI, so it must be unique in the export.
+            const auto filename = "atlas" + std::to_string(atlasIndex) + "_" + MaterialTexture::name(static_cast<MaterialTexture::Kind>(kind)) + ".png";
+            atlas.paths[kind] = cacheFolder / "atlas" / ContentHash::hex(hash.value()) / filename;
+
+            if (exists(atlas.paths[kind]))
+                continue;
+
+            // Read the source images. MImage is part of the Maya API, so this can't run in parallel.
+            Composition composition{&atlas, static_cast<MaterialTexture::Kind>(kind)};
+            for (const auto memberIndex : atlas.members) {
+                const auto &member = candidates[memberIndex];
+                const auto &sourcePath = getImagePath(member.textures[kind]->source);
+
+                MImage mayaImage;
+                unsigned width = 0;
+                unsigned height = 0;
+                THROW_ON_FAILURE_WITH(mayaImage.readFromFile(MString(sourcePath.c_str())),
+                                      formatted("Failed to read image %s", sourcePath.c_str()));
+                THROW_ON_FAILURE(mayaImage.getSize(width, height));
+                if (mayaImage.depth() != 4 || width != static_cast<unsigned>(member.width) || height != static_cast<unsigned>(member.height))
+                    throw MayaException(MStatus::kFailure, formatted("Image %s has an unexpected size or depth", sourcePath.c_str()));
+
+                composition.sourcePixels.emplace_back(mayaImage.pixels(), mayaImage.pixels() + width * height * 4);
+            }
+
+            compositions.emplace_back(std::move(composition));
+        }
+    }
+
+    ThreadPool::shared().parallelFor(compositions.size(), [&](const size_t index) {
+        auto &composition = compositions[index];
+        const auto &atlas = *composition.atlas;
+
+        composition.atlasPixels.resize(static_cast<size_t>(atlas.width) * atlas.height * 4);
+        for (size_t memberIndex = 0; memberIndex < atlas.members.size(); ++memberIndex) {
+            const auto &member = candidates[atlas.members[memberIndex]];
+            const auto &tile = atlas.tiles[memberIndex];
+            blitPaddedRGBA8(composition.sourcePixels[memberIndex].data(), member.width, member.height, composition.atlasPixels.data(),
+                            atlas.width, tile.x, tile.y, padding);
+        }
+        composition.sourcePixels = {};
+    });
+
+    // Write the atlases, also on the main thread.
+    for (auto &composition : compositions) {
+        const auto &atlas = *composition.atlas;
+        const auto &path = atlas.paths[composition.kind];
+
+        MImage mayaImage;
+        THROW_ON_FAILURE(
+            mayaImage.setPixels(composition.atlasPixels.data(), static_cast<unsigned>(atlas.width), static_cast<unsigned>(atlas.height)));
+
+        create_directories(path.parent_path());
+        auto partialPath = path;
+        partialPath += ".partial";
+
+        THROW_ON_FAILURE_WITH(mayaImage.writeToFile(MString(partialPath.c_str()), "png"),
+                              formatted("Failed to write image %s", partialPath.c_str()));
+
+        rename(partialPath, path);
+    }
+
+    // Merge the materials, and make their primitives address the tiles.
+    std::set<const ExportableMaterialBasePBR *> mergedMaterials;
+
+    for (const auto &atlas : atlases) {
+        const auto &first = candidates[atlas.members.front()];
+
+        MaterialTextures atlasTextures{};
+        for (size_t kind = 0; kind < MaterialTexture::COUNT; ++kind) {
+            const auto texture = first.textures[kind];
+            if (!texture)
+                continue;
+
+            if (kind == MaterialTexture::OCCLUSION && texture == first.textures[MaterialTexture::METALLIC_ROUGHNESS]) {
+                atlasTextures[kind] = atlasTextures[MaterialTexture::METALLIC_ROUGHNESS];
+                continue;
+            }
+
+            const auto hasColorData = kind == MaterialTexture::BASE_COLOR || kind == MaterialTexture::EMISSIVE;
+            const auto maxSize = m_args.maxTextureSizes[MaterialTexture::slot(static_cast<MaterialTexture::Kind>(kind))];
+            const auto image = getImage(atlas.paths[kind], hasColorData, maxSize);
+            if (!image)
+                throw MayaException(MStatus::kFailure, formatted("Failed to create atlas %s", atlas.paths[kind].c_str()));
+
+            atlasTextures[kind] = getTexture(image, texture->sampler);
+        }
+
+        const auto name = m_args.makeName("atlas#" + std::to_string(m_atlasMaterials.size()));
+        auto atlasMaterial = std::make_unique<ExportableAtlasMaterial>(name, *first.material, atlasTextures);
+
+        // MImage stores the rows bottom-up, while glTF texture coordinates start at the top.
+        const auto atlasWidth = static_cast<float>(atlas.width);
+        const auto atlasHeight = static_cast<float>(atlas.height);
+
+        for (size_t memberIndex = 0; memberIndex < atlas.members.size(); ++memberIndex) {
+            const auto &member = candidates[atlas.members[memberIndex]];
+            const auto &tile = atlas.tiles[memberIndex];
+            mergedMaterials.insert(member.material);
+
+            const float scale[] = {member.width / atlasWidth, member.height / atlasHeight};
+            const float offset[] = {(tile.x + padding) / atlasWidth, (atlas.height - tile.y - padding - member.height) / atlasHeight};
+
+            for (const auto primitive : member.primitives) {
+                const auto accessor = primitive->attributes.at("TEXCOORD_0");
+
+                float uv[2];
+                for (int index = 0; index < accessor->count; ++index) {
+                    accessor->getComponentAtIndex(index, uv);
+                    uv[0] = offset[0] + std::clamp(uv[0], 0.0f, 1.0f) * scale[0];
+                    uv[1] = offset[1] + std::clamp(uv[1], 0.0f, 1.0f) * scale[1];
+                    accessor->writeComponentAtIndex(index, uv);
+                }
+                accessor->computeMinMax();
+
+                primitive->material = atlasMaterial->glMaterial();
+            }
+        }
+
+        cout << prefix << "Merged " << atlas.members.size() << " materials into " << atlas.width << "x" << atlas.height
+             << " texture atlas material '" << name << "'" << endl;
+
+        m_atlasMaterials.emplace_back(std::move(atlasMaterial));
+    }
+
+    // The images of the merged materials are not exported, unless other materials use these too.
+    std::set<const GLTF::Image *> usedImages;
+    for (auto &pair : m_materialMap) {
+        const auto material = dynamic_cast<ExportableMaterialBasePBR *>(pair.second.get());
+        if (material && !mergedMaterials.count(material)) {
+            for (const auto texture : material->textures()) {
+                if (texture) {
+                    usedImages.insert(texture->source);
+                }
+            }
+        }
+    }
+
+    for (const auto material : mergedMaterials) {
+        for (const auto texture : material->textures()) {
+            if (texture && !usedImages.count(texture->source)) {
+                m_imageFiles.at(texture->source)->isAtlased = true;
+            }
+        }
+    }
+}
+
+void ExportableResources::finishImages() {
+    writePackedImages();
+    resizeImages();
+
+    std::map<std::pair<uint64_t, uint64_t>, GLTF::Image *> uniqueImages;
+    std::map<GLTF::Image *, GLTF::Image *> duplicateImages;
+    std::vector<GLTF::Image *> exportedImages;
+    std::set<const GLTF::Image *> failedImages;
+
+    for (const auto image : m_discoveredImages) {
+        auto &imageFile = *m_imageFiles.at(image);
+        if (!imageFile.loaded.valid())
+            continue;
+
         try {
-            imagePtr.reset(GLTF::Image::load(path.generic_string()));
+            imageFile.loaded.get();
         } catch (std::exception &ex) {
+            MayaException::printError(formatted("Failed to load image '%s': %s", imageFile.path.c_str(), ex.what()));
+            failedImages.insert(image);
+            continue;
+        }
+
+        if (imageFile.isAtlased)
+            continue;
+
+        auto &uniqueImage = uniqueImages[std::make_pair(imageFile.contentHash, imageFile.byteCount)];
+        if (uniqueImage) {
+            cout << prefix << "Image '" << imageFile.path << "' has the same contents as '" << getImagePath(uniqueImage)
+                 << "', exporting it once" << endl;
+            duplicateImages[image] = uniqueImage;
+
+            auto &uniqueImageFile = *m_imageFiles.at(uniqueImage);
+            uniqueImageFile.hasColorData &= imageFile.hasColorData;
+            uniqueImageFile.needsMips |= imageFile.needsMips;
+            continue;
+        }
+
+        uniqueImage = image;
+        exportedImages.push_back(image);
+
+        if (m_args.hashImageURIs) {
+            std::string ext = imageFile.path.extension().generic_string();
+            std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+            image->uri = ContentHash::hex(imageFile.contentHash) + ext;
+        }
+    }
+
+    if (m_args.ktx2Textures) {
+        encodeKtx2Images(exportedImages);
+    }
+
+    for (auto &pair : m_TextureMap) {
+        const auto &texture = pair.second;
+        const auto duplicate = duplicateImages.find(texture->source);
+        if (duplicate != duplicateImages.end()) {
+            texture->source = duplicate->second;
+        }
+    }
+
+    // The image of a texture must have data, so the materials lose the textures of the images that failed to load.
+    if (!failedImages.empty()) {
+        for (auto &pair : m_materialMap) {
+            const auto material = dynamic_cast<ExportableMaterialBasePBR *>(pair.second.get());
+            if (material) {
+                material->removeTextures(failedImages);
+            }
+        }
+        for (auto &atlasMaterial : m_atlasMaterials) {
+            static_cast<ExportableMaterialBasePBR *>(atlasMaterial.get())->removeTextures(failedImages);
+        }
+    }
+}
+
+// Encodes the image with the toktx tool of KTX-Software, unless the cache folder already has it.
+// Color data uses the small ETC1S mode, other data (normals, roughness...) the higher quality UASTC mode.
+static fs::path encodeKtx2(const std::string &encoder, const fs::path &folder, const fs::path &sourcePath,
+                           const uint64_t contentHash, const bool hasColorData, const bool needsMips) {
+    const auto mode = hasColorData ? "etc1s" : "uastc";
+    const auto targetPath = folder / (ContentHash::hex(contentHash) + "-" + mode + (needsMips ? "-mips" : "") + ".ktx2");
+    if (exists(targetPath))
+        return targetPath;
+
+    auto partialPath = targetPath;
+    partialPath += ".partial";
+
+    // The paths come from the scene, so these are passed as plain arguments, never through a shell
+    std::vector<std::string> arguments{encoder, "--t2", "--encode", mode};
+    if (!hasColorData) {
+        arguments.insert(arguments.end(), {"--assign_oetf", "linear"});
+    }
+    if (needsMips) {
+        arguments.emplace_back("--genmipmap");
+    }
+    arguments.emplace_back(partialPath.string());
+    arguments.emplace_back(sourcePath.string());
+
+    const auto exitCode = runProcess(arguments);
+    if (exitCode != 0 || !exists(partialPath))
+        throw std::runtime_error(formatted("%s failed with exit code %d for '%s'", encoder.c_str(), exitCode, sourcePath.string().c_str()));
+
+    rename(partialPath, targetPath);
+    return targetPath;
+}
+
+void ExportableResources::encodeKtx2Images(const std::vector<GLTF::Image *> &images) {
+    const auto folder = imageCacheFolder() / "ktx2";
+    create_directories(folder);
+
+    const std::string encoder = m_args.ktx2Encoder.asChar();
+    const auto isEmbedded = m_args.glb && !m_args.externalTextures;
+
+    std::vector<fs::path> encodedPaths(images.size());
+    std::vector<std::string> errors(images.size());
+
+    ThreadPool::shared().parallelFor(images.size(), [&](const size_t index) {
+        const auto image = images[index];
+        const auto &imageFile = *m_imageFiles.at(image);
+
+        try {
+            encodedPaths[index] =
+                encodeKtx2(encoder, folder, imageFile.path, imageFile.contentHash, imageFile.hasColorData, imageFile.needsMips);
+        } catch (std::exception &ex) {
+            errors[index] = ex.what();
+        }
+
+        if (isEmbedded) {
+            try {
+                loadImageData(image, (encodedPaths[index].empty() ? imageFile.path : encodedPaths[index]).generic_string());
+            } catch (std::exception &ex) {
+                errors[index] += formatted(" (failed to load the image: %s)", ex.what());
+            }
+        }
+    });
+
+    for (size_t index = 0; index < images.size(); ++index) {
+        const auto image = images[index];
+        auto &imageFile = *m_imageFiles.at(image);
+
+        if (encodedPaths[index].empty()) {
             MayaException::printError(
-                formatted("Failed to load image '%s': %s", path.c_str(), ex.what()));
+                formatted("Failed to encode image '%s' as KTX2, keeping it: %s", imageFile.path.c_str(), errors[index].c_str()));
+            continue;
         }
+
+        cout << prefix << "Encoded image '" << imageFile.path << "' as " << encodedPaths[index] << endl;
+
+        image->uri = fs::path(image->uri).replace_extension(".ktx2").generic_string();
+        image->mimeType = "image/ktx2";
+        imageFile.path = encodedPaths[index];
     }
-    return imagePtr.get();
+}
+
+static uint32_t readBigEndian(const uint8_t *bytes, const size_t byteCount) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < byteCount; ++i) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+static uint32_t readLittleEndian(const uint8_t *bytes, const size_t byteCount) {
+    uint32_t value = 0;
+    for (size_t i = byteCount; i-- > 0;) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+static bool readBytes(std::ifstream &file, uint8_t *bytes, const size_t byteCount) {
+    file.read(reinterpret_cast<char *>(bytes), byteCount);
+    return file.gcount() == static_cast<std::streamsize>(byteCount);
+}
+
+static void probePNG(std::ifstream &file, ImageMetadata &metadata) {
+    // The IHDR chunk must come first.
+    uint8_t header[26];
+    if (!readBytes(file, header, sizeof(header)) || memcmp(header + 12, "IHDR", 4) != 0)
+        return;
+
+    metadata.width = readBigEndian(header + 16, 4);
+    metadata.height = readBigEndian(header + 20, 4);
+
+    const auto colorType = header[25];
+    metadata.hasAlpha = colorType == 4 || colorType == 6;
+
+    // Otherwise a tRNS chunk before the image data makes a color transparent.
+    file.seekg(8 + 4 + 4 + 13 + 4);
+    uint8_t chunk[8];
+    while (!metadata.hasAlpha && readBytes(file, chunk, sizeof(chunk))) {
+        if (memcmp(chunk + 4, "IDAT", 4) == 0 || memcmp(chunk + 4, "IEND", 4) == 0)
+            break;
+        metadata.hasAlpha = memcmp(chunk + 4, "tRNS", 4) == 0;
+        file.seekg(readBigEndian(chunk, 4) + 4, std::ios::cur);
+    }
+}
+
+static void probeJPEG(std::ifstream &file, ImageMetadata &metadata) {
+    // Skip the segments until the start-of-frame, which holds the dimensions.
+    file.seekg(2);
+    uint8_t marker[4];
+    while (readBytes(file, marker, 2) && marker[0] == 0xFF) {
+        const auto code = marker[1];
+        if (code == 0xFF) {
+            // Fill byte
+            file.seekg(-1, std::ios::cur);
+            continue;
+        }
+        if (code == 0x01 || (code >= 0xD0 && code <= 0xD8))
+            continue;
+        if (code == 0xD9 || code == 0xDA)
+            break;
+        if (!readBytes(file, marker + 2, 2))
+            break;
+
+        const auto segmentLength = readBigEndian(marker + 2, 2);
+        if (code >= 0xC0 && code <= 0xCF && code != 0xC4 && code != 0xC8 && code != 0xCC) {
+            uint8_t frame[5];
+            if (readBytes(file, frame, sizeof(frame))) {
+                metadata.height = readBigEndian(frame + 1, 2);
+                metadata.width = readBigEndian(frame + 3, 2);
+            }
+            break;
+        }
+        file.seekg(segmentLength - 2, std::ios::cur);
+    }
+}
+
+static void probeDDS(std::ifstream &file, ImageMetadata &metadata) {
+    uint8_t header[88];
+    if (!readBytes(file, header, sizeof(header)))
+        return;
+
+    metadata.height = readLittleEndian(header + 12, 4);
+    metadata.width = readLittleEndian(header + 16, 4);
+
+    const auto pixelFormatFlags = readLittleEndian(header + 80, 4);
+    const auto fourCC = header + 84;
+    const auto hasAlphaPixels = (pixelFormatFlags & 0x1) != 0;
+    const auto hasAlphaBlocks = memcmp(fourCC, "DXT", 3) == 0 && fourCC[3] >= '2' && fourCC[3] <= '5';
+    metadata.hasAlpha = hasAlphaPixels || hasAlphaBlocks;
+}
+
+ImageMetadata ImageMetadata::probe(const fs::path &path) {
+    ImageMetadata metadata;
+
+    std::ifstream file(path.generic_string(), std::ios::in | std::ios::binary);
+
+    uint8_t signature[8];
+    if (!readBytes(file, signature, sizeof(signature)))
+        return metadata;
+
+    file.seekg(0);
+
+    if (memcmp(signature, "\x89PNG\r\n\x1A\n", 8) == 0) {
+        probePNG(file, metadata);
+    } else if (signature[0] == 0xFF && signature[1] == 0xD8) {
+        probeJPEG(file, metadata);
+    } else if (memcmp(signature, "DDS ", 4) == 0) {
+        probeDDS(file, metadata);
+    }
+
+    return metadata;
 }
 
 static GLTF::Constants::WebGL
@@ -169,6 +1140,16 @@ GLTF::Texture *ExportableResources::getTexture(GLTF::Image *image,
 
     auto &texturePtr = m_TextureMap[key];
     if (!texturePtr) {
+        switch (sampler->minFilter) {
+        case GLTF::Constants::WebGL::NEAREST_MIPMAP_NEAREST:
+        case GLTF::Constants::WebGL::LINEAR_MIPMAP_NEAREST:
+        case GLTF::Constants::WebGL::NEAREST_MIPMAP_LINEAR:
+        case GLTF::Constants::WebGL::LINEAR_MIPMAP_LINEAR:
+            m_imageFiles.at(image)->needsMips = true;
+            break;
+        default:;
+        }
+
         texturePtr = std::make_unique<GLTF::Texture>();
         texturePtr->source = image;
         texturePtr->sampler = sampler;
@@ -21,6 +21,18 @@ enum ImageFilterKind {
     IMAGE_FILTER_Gaussian = 5
 };
 
+// The metadata of an image file, probed from its header without reading the pixels.
+struct ImageMetadata {
+    // Zero when the image format is not recognized
+    int width = 0;
+    int height = 0;
+
+    // Does the image have an alpha channel or a transparent color key?
+    bool hasAlpha = false;
+
+    static ImageMetadata probe(const fs::path &path);
+};
+
 class ExportableResources : public ExportableItem {
   public:
     ExportableResources(const Arguments &args);
@@ -32,7 +44,35 @@ class ExportableResources : public ExportableItem {
     ExportableMaterial *getDebugMaterial(const Float3 &hue);
     ExportableMaterial *getMaterial(const MObject &shaderGroup);
 
-    GLTF::Image *getImage(fs::path path);
+    // Returns the image for the file, with its data loaded asynchronously when the image is embedded.
+    // The data must not be used before finishImages is called.
+    // Images without color data, like normal maps, are encoded differently when exporting KTX2 textures,
+    // and are downscaled without gamma correction. Images larger than a positive maxSize are downscaled.
+    GLTF::Image *getImage(fs::path path, bool hasColorData = true, int maxSize = 0);
+
+    // Returns the image that packs the occlusion, roughness and metallic images into its red, green and blue channels.
+    // The occlusion path can be empty. Images with different sizes are downscaled to the smallest of these.
+    // The packing runs asynchronously, and its result is cached by the contents of the source images.
+    GLTF::Image *getPackedImage(const fs::path &occlusionPath, const fs::path &roughnessPath, const fs::path &metallicPath,
+                                int maxSize = 0);
+
+    // The metadata of an image returned by getImage, available immediately.
+    const ImageMetadata &getImageMetadata(const GLTF::Image *image) const { return m_imageFiles.at(image)->metadata; }
+
+    // The file an image returned by getImage is read from.
+    const fs::path &getImagePath(const GLTF::Image *image) const { return m_imageFiles.at(image)->path; }
+
+    // The folder with the content hashes of the image files, see ContentHash::ofIndexedFile.
+    fs::path imageHashIndexFolder() const;
+
+    // Packs the small textures of materials that only differ by their textures into atlases, and merges these materials.
+    // Rewrites the TEXCOORD_0 accessors of the primitives that use the merged materials, so these must not be packed yet.
+    void atlasTextures(const std::vector<GLTF::Primitive *> &primitives);
+
+    // Waits until the images are loaded and hashed, and reports the images that failed to load.
+    // Textures of images with the same contents are redirected to the first of these images,
+    // and the materials lose the textures of images that failed to load.
+    void finishImages();
 
     GLTF::Sampler *getSampler(const ImageFilterKind filter,
                               const ImageTilingFlags uTiling,
@@ -47,6 +87,30 @@ class ExportableResources : public ExportableItem {
     void getAllAccessors(std::vector<GLTF::Accessor *> &accessors);
 
   private:
+    struct ImageFile {
+        fs::path path;
+        ImageMetadata metadata;
+        std::future<void> loaded;
+
+        // Written by the loading task
+        uint64_t contentHash = 0;
+        uint64_t byteCount = 0;
+
+        // How the image is used by the textures
+        bool hasColorData = true;
+        bool needsMips = false;
+        int maxSize = 0;
+
+        // Only used by materials that were merged into atlas materials, so not exported
+        bool isAtlased = false;
+
+        // The pixels of a packed image, written by the packing task
+        std::future<void> packed;
+        std::vector<uint8_t> packedPixels;
+
+        bool needsResize() const { return maxSize > 0 && std::max(metadata.width, metadata.height) > maxSize; }
+    };
+
     std::map<MayaNodeName, std::unique_ptr<ExportableMaterial>> m_materialMap;
     std::map<Float3, std::unique_ptr<ExportableMaterial>> m_debugMaterialMap;
     std::map<std::string, std::unique_ptr<GLTF::Image>> m_imageMap;
@@ -54,7 +118,31 @@ class ExportableResources : public ExportableItem {
     std::map<std::pair<GLTF::Image *, GLTF::Sampler *>,
              std::unique_ptr<GLTF::Texture>>
         m_TextureMap;
+    std::map<const GLTF::Image *, std::unique_ptr<ImageFile>> m_imageFiles;
+    std::vector<GLTF::Image *> m_discoveredImages;
+    std::vector<std::unique_ptr<ExportableMaterial>> m_atlasMaterials;
 
     ExportableDefaultMaterial m_defaultMaterial;
     const Arguments &m_args;
+
+    // The folder where converted and encoded images are kept between exports
+    fs::path imageCacheFolder() const;
+
+    // Converts the image to PNG, or reuses the PNG in the cache folder that was converted from the same contents.
+    fs::path convertImage(const fs::path &sourcePath) const;
+
+    // Creates the image and its file, without probing or loading it.
+    ImageFile &addImage(std::unique_ptr<GLTF::Image> &imagePtr, const fs::path &path, bool hasColorData, int maxSize);
+
+    // Writes the packed images, once their packing tasks are done.
+    void writePackedImages();
+
+    // Starts loading the data of an embedded image, or hashing the file of an external image.
+    void startLoading(GLTF::Image *image, ImageFile &imageFile) const;
+
+    // Downscales the images that are larger than their maximum size in parallel, or reuses these from the cache folder.
+    void resizeImages();
+
+    // Encodes the images as KTX2 in parallel, and makes these reference the encoded files.
+    void encodeKtx2Images(const std::vector<GLTF::Image *> &images);
 };
@@ -1,8 +1,10 @@
 #include "externals.h"
 
+#include "DagHelper.h"
 #include "ExportableNode.h"
 #include "ExportableScene.h"
 #include "MayaException.h"
+#include "MayaUtils.h"
 
 ExportableScene::ExportableScene(ExportableResources &resources) : m_resources(resources) {}
 
@@ -19,6 +21,24 @@ void ExportableScene::updateCurrentValues() {
     }
 }
 
+void ExportableScene::finishMeshes() {
+    for (auto &&pair : m_table) {
+        auto *mesh = pair.second->mesh();
+        if (mesh) {
+            mesh->finish();
+        }
+    }
+}
+
+void ExportableScene::getAllPrimitives(std::vector<GLTF::Primitive *> &primitives) const {
+    for (auto &&pair : m_table) {
+        auto *mesh = pair.second->mesh();
+        if (mesh) {
+            primitives.insert(primitives.end(), mesh->glMesh.primitives.begin(), mesh->glMesh.primitives.end());
+        }
+    }
+}
+
 void ExportableScene::mergeRedundantShapeNodes() {
     std::set<NodeTable::key_type> redundantKeys;
 
@@ -34,6 +54,178 @@ void ExportableScene::mergeRedundantShapeNodes() {
     }
 }
 
+void ExportableScene::flattenStaticHierarchy(const bool isAnimated) {
+    const auto &args = arguments();
+
+    // Nodes with animation channels can't be moved, nor can their parents, their channels hold local transforms.
+    const auto hasChannels = [&](const ExportableNode *node) {
+        return isAnimated && (!node->isStatic || args.forceAnimationChannels || args.forceAnimationSampling);
+    };
+
+    // The logical children of each node, in the order of the table
+    std::map<const ExportableNode *, std::vector<ExportableNode *>> childNodes;
+    for (auto &&pair : m_table) {
+        auto &node = pair.second;
+        childNodes[node->parentNode].push_back(node.get());
+    }
+
+    std::set<NodeTable::key_type> flattenedKeys;
+
+    for (auto &&pair : m_table) {
+        auto *node = pair.second.get();
+
+        if (node->obj.hasFn(MFn::kJoint) || hasChannels(node))
+            continue;
+
+        // Meshes (also skinned ones) and cameras need their node. Meshes merged into a static batch no longer do.
+        auto &glPrimaryNode = node->glPrimaryNode();
+        if (glPrimaryNode.mesh || glPrimaryNode.camera)
+            continue;
+
+        bool isKept = false;
+        DagHelper::getPlugValue(node->obj, "MGk", isKept);
+        if (isKept)
+            continue;
+
+        auto &children = childNodes[node];
+
+        if (std::any_of(children.begin(), children.end(), hasChannels))
+            continue;
+
+        // GLTF can't represent skewed transforms
+        const auto localMatrix = node->glLocalMatrix();
+
+        std::vector<MMatrix> childMatrices;
+        childMatrices.reserve(children.size());
+        for (auto *child : children) {
+            childMatrices.emplace_back(child->glSecondaryMatrix() * localMatrix);
+        }
+
+        const auto isSkewed = [](const MMatrix &m) { return getAxesNonOrthogonality(m) > MAX_NON_ORTHOGONALITY; };
+        if (std::any_of(childMatrices.begin(), childMatrices.end(), isSkewed))
+            continue;
+
+        for (size_t i = 0; i < children.size(); ++i) {
+            children[i]->setSecondaryMatrix(childMatrices[i]);
+        }
+
+        // Replace the GLTF node by the GLTF children, at the same position
+        auto *parentNode = node->parentNode;
+        const auto &glChildren = glPrimaryNode.children;
+
+        if (parentNode) {
+            auto &glSiblings = parentNode->glPrimaryNode().children;
+            const auto it = std::find(glSiblings.begin(), glSiblings.end(), &node->glSecondaryNode());
+            assert(it != glSiblings.end());
+            glSiblings.insert(glSiblings.erase(it), glChildren.begin(), glChildren.end());
+        } else {
+            m_orphans.erase(node->dagPath);
+        }
+
+        auto &parentChildren = childNodes[parentNode];
+        parentChildren.erase(std::find(parentChildren.begin(), parentChildren.end(), node));
+
+        for (auto *child : children) {
+            child->parentNode = parentNode;
+            parentChildren.push_back(child);
+
+            if (!parentNode) {
+                registerOrphanNode(child);
+            }
+        }
+
+        children.clear();
+        flattenedKeys.insert(pair.first);
+    }
+
+    for (auto &&key : flattenedKeys) {
+        m_table.erase(key);
+    }
+
+    cout << prefix << "Flattened " << flattenedKeys.size() << " static nodes, " << m_table.size() << " nodes remain" << endl;
+}
+
+void ExportableScene::detectStaticNodes() {
+    MStatus status;
+
+    // Joints driven by an IK solver have no incoming connections,
+    // so collect all joints between the start joint and the end effector.
+    std::set<std::string> ikJointPaths;
+
+    for (MItDependencyNodes itHandle(MFn::kIkHandle); !itHandle.isDone(); itHandle.next()) {
+        MFnIkHandle fnHandle(itHandle.thisNode(), &status);
+        if (!status)
+            continue;
+
+        MDagPath startJointPath;
+        MDagPath effectorPath;
+        if (!fnHandle.getStartJoint(startJointPath) || !fnHandle.getEffector(effectorPath))
+            continue;
+
+        // The end effector is a child of the end joint
+        for (auto jointPath = effectorPath; jointPath.pop() && jointPath.length() > 0;) {
+            ikJointPaths.insert(jointPath.fullPathName().asChar());
+            if (jointPath == startJointPath)
+                break;
+        }
+    }
+
+    // Many nodes share the same DAG ancestors, so each ancestor is checked once.
+    std::map<std::string, bool> timeDependentPaths;
+
+    std::function<bool(const MDagPath &)> hasTimeDependentTransform = [&](const MDagPath &dagPath) {
+        if (dagPath.length() == 0)
+            return false;
+
+        const std::string fullPath{dagPath.fullPathName().asChar()};
+        const auto it = timeDependentPaths.find(fullPath);
+        if (it != timeDependentPaths.end())
+            return it->second;
+
+        auto parentPath = dagPath;
+        parentPath.pop();
+
+        const auto result = utils::hasTimeDependentLocalTransform(dagPath) || hasTimeDependentTransform(parentPath);
+        timeDependentPaths[fullPath] = result;
+        return result;
+    };
+
+    std::map<const ExportableNode *, bool> staticNodes;
+
+    std::function<bool(const ExportableNode *)> isStatic = [&](const ExportableNode *node) {
+        const auto it = staticNodes.find(node);
+        if (it != staticNodes.end())
+            return it->second;
+
+        // Assume dynamic while visiting, this also breaks cycles between logical parents.
+        staticNodes[node] = false;
+
+        auto result = !ikJointPaths.count(node->dagPath.fullPathName().asChar()) && !hasTimeDependentTransform(node->dagPath);
+
+        if (result && node->mesh()) {
+            result = !node->mesh()->hasTimeDependentWeights();
+        }
+
+        // The local transform is relative to the glTF parent, which is not always the DAG parent.
+        if (result && node->parentNode) {
+            result = isStatic(node->parentNode);
+        }
+
+        staticNodes[node] = result;
+        return result;
+    };
+
+    size_t staticNodeCount = 0;
+
+    for (auto &&pair : m_table) {
+        auto &node = pair.second;
+        node->isStatic = isStatic(node.get());
+        staticNodeCount += node->isStatic;
+    }
+
+    cout << prefix << staticNodeCount << " of " << m_table.size() << " nodes are not animated and will not be sampled" << endl;
+}
+
 ExportableNode *ExportableScene::getNode(const MDagPath &dagPath) {
     MStatus status;
 
@@ -31,6 +31,18 @@ class ExportableScene {
 
     void mergeRedundantShapeNodes();
 
+    // Removes the static transform nodes without shapes, baking their local transforms into their children.
+    // Joints, animated nodes, parents of animated nodes and nodes marked with the Maya2glTF_keep attribute are kept.
+    // When the scene is animated, the static nodes must be detected first.
+    void flattenStaticHierarchy(bool isAnimated);
+
+    // Waits for the primitives of all meshes, in a fixed order.
+    void finishMeshes();
+
+    // Marks all nodes whose local transforms and blend shape weights are
+    // provably not animated, so they don't need to be sampled.
+    void detectStaticNodes();
+
     // Gets or creates the node
     // Returns null if the DAG path has no node
     ExportableNode *getNode(const MDagPath &dagPath);
@@ -41,6 +53,9 @@ class ExportableScene {
 
     void getAllAccessors(AccessorsPerDagPath &accessors);
 
+    // The primitives of all meshes, in a fixed order
+    void getAllPrimitives(std::vector<GLTF::Primitive *> &primitives) const;
+
     // Register a node without parent
     void registerOrphanNode(ExportableNode *node);
 
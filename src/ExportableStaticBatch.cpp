@@ -0,0 +1,246 @@
+#include "externals.h"
+
+#include "Arguments.h"
+#include "ExportableMaterial.h"
+#include "ExportableNode.h"
+#include "ExportablePrimitive.h"
+#include "ExportableResources.h"
+#include "ExportableScene.h"
+#include "ExportableStaticBatch.h"
+#include "ThreadPool.h"
+#include "spans.h"
+
+namespace {
+// A vertex buffer with the world matrices to bake into it.
+// The matrices are plain copies, so the vertices can be transformed on the worker threads.
+struct BakedVertexBuffer {
+    MaterialVertexBuffer buffer;
+    double pointMatrix[4][4];
+    double normalMatrix[4][4];
+    bool isMirrored;
+};
+
+// The vertices of buffers with the same material and vertex layout are concatenated
+struct BatchGroup {
+    ExportableMaterial *material;
+    VertexLayout layout;
+    std::vector<size_t> bufferIndices;
+};
+
+VertexLayout sortedLayout(const VertexBuffer &vertexBuffer) {
+    VertexLayout layout;
+    layout.reserve(vertexBuffer.componentsMap.size());
+
+    for (auto &&pair : vertexBuffer.componentsMap) {
+        layout.emplace_back(pair.first);
+    }
+
+    std::sort(layout.begin(), layout.end());
+    return layout;
+}
+
+// Multiplies the first 3 components of each element as a row vector with the matrix, like Maya does.
+// The weight is 1 for points and 0 for directions, which are normalized.
+void transformElements(VertexElementData &data, const size_t dimension, const double (&m)[4][4], const double w) {
+    if (data.empty())
+        return;
+
+    auto values = mutable_span(reinterpret_span<float>(data));
+
+    for (size_t offset = 0; offset + dimension <= values.size(); offset += dimension) {
+        const double x = values[offset + 0];
+        const double y = values[offset + 1];
+        const double z = values[offset + 2];
+
+        double result[3];
+        for (int column = 0; column < 3; ++column) {
+            result[column] = x * m[0][column] + y * m[1][column] + z * m[2][column] + w * m[3][column];
+        }
+
+        if (w == 0) {
+            const auto length = std::sqrt(result[0] * result[0] + result[1] * result[1] + result[2] * result[2]);
+            if (length > 0) {
+                result[0] /= length;
+                result[1] /= length;
+                result[2] /= length;
+            }
+        }
+
+        values[offset + 0] = static_cast<float>(result[0]);
+        values[offset + 1] = static_cast<float>(result[1]);
+        values[offset + 2] = static_cast<float>(result[2]);
+    }
+}
+
+void bakeWorldMatrix(BakedVertexBuffer &baked) {
+    auto &vertexBuffer = baked.buffer.vertexBuffer;
+
+    for (auto &&pair : vertexBuffer.componentsMap) {
+        const auto &slot = pair.first;
+        auto &data = pair.second;
+
+        switch (slot.semantic) {
+        case Semantic::POSITION:
+            transformElements(data, slot.dimension(), baked.pointMatrix, 1);
+            break;
+        case Semantic::NORMAL:
+            transformElements(data, slot.dimension(), baked.normalMatrix, 0);
+            break;
+        case Semantic::TANGENT:
+            transformElements(data, slot.dimension(), baked.pointMatrix, 0);
+
+            if (baked.isMirrored && slot.dimension() == 4 && !data.empty()) {
+                // The bitangent sign flips with the handedness
+                auto values = mutable_span(reinterpret_span<float>(data));
+                for (size_t offset = 3; offset < values.size(); offset += 4) {
+                    values[offset] = -values[offset];
+                }
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (baked.isMirrored) {
+        // Keep the triangles front facing
+        auto &indices = vertexBuffer.indices;
+        for (size_t offset = 0; offset + 2 < indices.size(); offset += 3) {
+            std::swap(indices[offset + 1], indices[offset + 2]);
+        }
+    }
+}
+
+void append(VertexBuffer &target, const VertexBuffer &source, const VertexLayout &layout) {
+    const auto indexOffset = static_cast<Index>(target.maxIndex());
+
+    target.indices.reserve(target.indices.size() + source.indices.size());
+    for (const auto index : source.indices) {
+        target.indices.push_back(index + indexOffset);
+    }
+
+    for (auto &slot : layout) {
+        auto &targetData = target.componentsMap[slot];
+        auto &sourceData = source.componentsMap.at(slot);
+        targetData.insert(targetData.end(), sourceData.begin(), sourceData.end());
+    }
+
+    target.vertexCount += source.maxIndex();
+}
+} // namespace
+
+ExportableStaticBatch::ExportableStaticBatch(ExportableScene &scene, const bool isAnimated) {
+    auto &resources = scene.resources();
+    auto &args = resources.arguments();
+
+    // Detach the vertex buffers on the main thread, the world matrices use the Maya matrix math.
+    std::vector<BakedVertexBuffer> bakedBuffers;
+    size_t meshCount = 0;
+
+    for (auto &&pair : scene.table()) {
+        auto &node = pair.second;
+        auto *mesh = node->mesh();
+
+        if (!mesh || !mesh->isMergeable())
+            continue;
+
+        // The animated nodes keep their meshes.
+        if (isAnimated && !node->isStatic)
+            continue;
+
+        const auto worldMatrix = node->glWorldMatrix();
+        const auto determinant = worldMatrix.det3x3();
+
+        // A collapsed mesh can't be baked, the normals would be undefined
+        if (determinant == 0)
+            continue;
+
+        const auto normalMatrix = worldMatrix.inverse().transpose();
+
+        for (auto &&buffer : mesh->detachVertexBuffers()) {
+            BakedVertexBuffer baked{std::move(buffer)};
+            worldMatrix.get(baked.pointMatrix);
+            normalMatrix.get(baked.normalMatrix);
+            baked.isMirrored = determinant < 0;
+            bakedBuffers.emplace_back(std::move(baked));
+        }
+
+        node->glPrimaryNode().mesh = nullptr;
+        ++meshCount;
+    }
+
+    if (bakedBuffers.empty())
+        return;
+
+    ThreadPool::shared().parallelFor(bakedBuffers.size(), [&bakedBuffers](size_t index) { bakeWorldMatrix(bakedBuffers[index]); });
+
+    // Group the buffers in the order of the scene, so the output is deterministic
+    std::vector<BatchGroup> groups;
+
+    for (size_t index = 0; index < bakedBuffers.size(); ++index) {
+        const auto &buffer = bakedBuffers[index].buffer;
+        auto layout = sortedLayout(buffer.vertexBuffer);
+
+        auto it = std::find_if(groups.begin(), groups.end(),
+                               [&](const BatchGroup &group) { return group.material == buffer.material && group.layout == layout; });
+
+        if (it == groups.end()) {
+            groups.push_back({buffer.material, std::move(layout)});
+            it = std::prev(groups.end());
+        }
+
+        it->bufferIndices.push_back(index);
+    }
+
+    // Concatenate the buffers of each group, starting a new primitive when 16-bit indices would no longer suffice
+    const size_t maxVertexCount = args.force32bitIndices ? std::numeric_limits<Index>::max() : std::numeric_limits<uint16_t>::max();
+
+    std::vector<MaterialVertexBuffer> mergedBuffers;
+
+    for (auto &group : groups) {
+        MaterialVertexBuffer merged{group.material};
+
+        for (const auto index : group.bufferIndices) {
+            const auto &vertexBuffer = bakedBuffers[index].buffer.vertexBuffer;
+
+            if (merged.vertexBuffer.vertexCount > 0 && merged.vertexBuffer.vertexCount + vertexBuffer.maxIndex() > maxVertexCount) {
+                mergedBuffers.emplace_back(std::move(merged));
+                merged = MaterialVertexBuffer{group.material};
+            }
+
+            append(merged.vertexBuffer, vertexBuffer, group.layout);
+        }
+
+        mergedBuffers.emplace_back(std::move(merged));
+    }
+
+    bakedBuffers.clear();
+
+    const auto name = args.makeName("staticBatch");
+
+    m_primitives.resize(mergedBuffers.size());
+
+    ThreadPool::shared().parallelFor(mergedBuffers.size(), [&](size_t index) {
+        const auto &merged = mergedBuffers[index];
+        m_primitives[index] =
+            std::make_unique<ExportablePrimitive>(name + "#" + std::to_string(index), merged.vertexBuffer, resources, merged.material);
+    });
+
+    for (auto &&primitive : m_primitives) {
+        glMesh.primitives.push_back(&primitive->glPrimitive);
+    }
+
+    glMesh.name = name;
+    glNode.name = name;
+    glNode.mesh = &glMesh;
+
+    cout << prefix << "Merged " << meshCount << " static meshes into " << m_primitives.size() << " primitives" << endl;
+}
+
+ExportableStaticBatch::~ExportableStaticBatch() = default;
+
+void ExportableStaticBatch::getAllAccessors(std::vector<GLTF::Accessor *> &accessors) const {
+    for (auto &&primitive : m_primitives) {
+        primitive->getAllAccessors(accessors);
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "ExportableMesh.h"
+
+class ExportableScene;
+class ExportablePrimitive;
+
+// The meshes of static nodes, with their world transforms baked into the vertices,
+// merged into as few primitives as possible, per material and vertex layout.
+// The nodes themselves are kept, so animation channels keep their targets, only their meshes move to this batch.
+class ExportableStaticBatch {
+  public:
+    // Moves the mergeable meshes of the scene into this batch.
+    // When the scene is animated, only the meshes of static nodes are merged, see ExportableScene::detectStaticNodes.
+    ExportableStaticBatch(ExportableScene &scene, bool isAnimated);
+    ~ExportableStaticBatch();
+
+    // The node that holds the merged mesh, in world space
+    GLTF::Node glNode;
+    GLTF::Mesh glMesh;
+
+    bool isEmpty() const { return m_primitives.empty(); }
+
+    void getAllAccessors(std::vector<GLTF::Accessor *> &accessors) const;
+
+  private:
+    DISALLOW_COPY_MOVE_ASSIGN(ExportableStaticBatch);
+
+    std::vector<std::unique_ptr<ExportablePrimitive>> m_primitives;
+};
@@ -8,7 +8,10 @@
 
 ExportableTexture::ExportableTexture(Private, ExportableResources &resources,
                                      const MObject &obj,
-                                     const char *attributeName) {
+                                     const char *attributeName,
+                                     const TextureSlot::Kind slot,
+                                     const bool loadsImage)
+    : m_slot(slot) {
     if (resources.arguments().skipMaterialTextures)
         return;
 
@@ -61,26 +64,56 @@ ExportableTexture::ExportableTexture(Private, ExportableResources &resources,
                                      static_cast<ImageTilingFlags>(vTiling));
     assert(glSampler);
 
-    const auto imagePtr = resources.getImage(imageFilePath.asChar());
+    // Maya uses a Raw color space for non-color data, like normal maps.
+    MString colorSpace;
+    DagHelper::getPlugValue(connectedObject, "colorSpace", colorSpace);
+    m_hasColorData = strstr(colorSpace.asChar(), "Raw") == nullptr;
+
+    if (loadsImage) {
+        load(resources);
+    }
+}
+
+GLTF::Texture *ExportableTexture::load(ExportableResources &resources) {
+    if (glTexture || !glSampler)
+        return glTexture;
+
+    const auto maxSize = resources.arguments().maxTextureSizes[m_slot];
+
+    const auto imagePtr = resources.getImage(imageFilePath.asChar(), m_hasColorData, maxSize);
     if (imagePtr) {
         glTexture = resources.getTexture(imagePtr, glSampler);
         assert(glTexture);
     }
+
+    return glTexture;
 }
 
 std::unique_ptr<ExportableTexture>
 ExportableTexture::tryCreate(ExportableResources &resources, const MObject &obj,
-                             const char *attributeName) {
+                             const char *attributeName,
+                             const TextureSlot::Kind slot) {
 
-    auto instance = std::make_unique<ExportableTexture>(Private(), resources,
-                                                        obj, attributeName);
+    auto instance = std::make_unique<ExportableTexture>(
+        Private(), resources, obj, attributeName, slot, true);
     return instance->glTexture ? std::move(instance) : nullptr;
 }
 
+std::unique_ptr<ExportableTexture>
+ExportableTexture::tryResolve(ExportableResources &resources, const MObject &obj,
+                              const char *attributeName,
+                              const TextureSlot::Kind slot) {
+
+    auto instance = std::make_unique<ExportableTexture>(
+        Private(), resources, obj, attributeName, slot, false);
+    return instance->glSampler ? std::move(instance) : nullptr;
+}
+
 GLTF::Texture *ExportableTexture::tryLoad(ExportableResources &resources,
                                           const MObject &obj,
-                                          const char *attributeName) {
-    const auto instance = tryCreate(resources, obj, attributeName);
+                                          const char *attributeName,
+                                          const TextureSlot::Kind slot) {
+    const auto instance = tryCreate(resources, obj, attributeName, slot);
     return instance ? instance->glTexture : nullptr;
 }
 
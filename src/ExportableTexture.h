@@ -1,6 +1,7 @@
 #pragma once
 
 #include "macros.h"
+#include "sceneTypes.h"
 class ExportableResources;
 
 /** The ExportableTexture just creates textures and samples in the resources, it
@@ -9,13 +10,30 @@ class ExportableTexture {
     struct Private {};
 
   public:
+    // The slot selects the maximum texture size, if any
     static std::unique_ptr<ExportableTexture>
     tryCreate(ExportableResources &resources, const MObject &obj,
-              const char *attributeName);
+              const char *attributeName, TextureSlot::Kind slot);
 
     static GLTF::Texture *tryLoad(ExportableResources &resources,
                                   const MObject &obj,
-                                  const char *attributeName);
+                                  const char *attributeName,
+                                  TextureSlot::Kind slot);
+
+    // Only resolves the image path and the sampler, without loading the image.
+    // Used for the source images of packed textures, these are not exported unless load is called.
+    static std::unique_ptr<ExportableTexture>
+    tryResolve(ExportableResources &resources, const MObject &obj,
+               const char *attributeName, TextureSlot::Kind slot);
+
+    // Loads the image of a resolved texture, and creates its GLTF texture, if not done yet.
+    // Returns null if the image can't be loaded.
+    GLTF::Texture *load(ExportableResources &resources);
+
+    // Do both textures use the same image and sampler?
+    bool isSameAs(const ExportableTexture &other) const {
+        return glSampler == other.glSampler && imageFilePath == other.imageFilePath;
+    }
 
     virtual ~ExportableTexture();
 
@@ -26,9 +44,13 @@ class ExportableTexture {
     MString imageFilePath;
 
     ExportableTexture(Private, ExportableResources &resources,
-                      const MObject &obj, const char *attributeName);
+                      const MObject &obj, const char *attributeName,
+                      TextureSlot::Kind slot, bool loadsImage);
 
   private:
+    bool m_hasColorData = true;
+    TextureSlot::Kind m_slot = TextureSlot::INVALID;
+
     ExportableTexture() = default;
     DISALLOW_COPY_MOVE_ASSIGN(ExportableTexture);
 };
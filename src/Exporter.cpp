@@ -5,6 +5,8 @@
 #include "Exporter.h"
 #include "MayaException.h"
 #include "OutputWindow.h"
+#include "TimelineSampler.h"
+#include "progress.h"
 
 Exporter::Exporter() = default;
 
@@ -84,18 +86,77 @@ void Exporter::exportScene(const Arguments &args) {
     exportableAsset.save();
 }
 
+void Exporter::exportScenes(const std::vector<std::unique_ptr<Arguments>> &groups) {
+    std::vector<const Arguments *> groupArgs;
+    for (auto &args : groups) {
+        groupArgs.push_back(args.get());
+    }
+
+    uiSetupProgress(ExportableAsset::progressStepCount(groupArgs));
+
+    struct ProgressTeardown {
+        ~ProgressTeardown() { uiTeardownProgress(); }
+    } progressTeardown;
+
+    TimelineSampler sampler(groups.front()->redrawViewport);
+
+    std::vector<std::unique_ptr<ExportableAsset>> assets;
+    assets.reserve(groups.size());
+
+    for (auto &args : groups) {
+        std::cout << prefix << "Extracting export group '" << args->sceneName << "'..." << endl;
+        assets.emplace_back(std::make_unique<ExportableAsset>(*args, &sampler));
+    }
+
+    const auto sampleTimeCount = sampler.run();
+    std::cout << prefix << "Evaluated " << sampleTimeCount << " distinct times for " << groups.size() << " export groups" << endl;
+
+    for (auto &asset : assets) {
+        asset->finishClips();
+        asset->save();
+
+        // Release the memory of each asset as soon as possible
+        asset.reset();
+    }
+}
+
 MStatus Exporter::run(const MArgList &args) const {
     try {
         std::cout << prefix << "Parsing arguments..." << endl;
-        const Arguments arguments(args, syntax());
-
-        if (arguments.clearOutputWindow) {
-            OutputWindow().clear();
+        const auto groupArgLists = Arguments::splitExportGroups(args);
+
+        if (groupArgLists.empty()) {
+            const Arguments arguments(args, syntax());
+
+            if (arguments.clearOutputWindow) {
+                OutputWindow().clear();
+            }
+
+            std::cout << prefix << "Starting export..." << endl;
+            exportScene(arguments);
+        } else {
+            std::vector<std::unique_ptr<Arguments>> groups;
+            groups.reserve(groupArgLists.size());
+
+            for (auto &groupArgList : groupArgLists) {
+                groups.emplace_back(std::make_unique<Arguments>(groupArgList, syntax()));
+            }
+
+            // The output window and the timeline are shared by all groups
+            for (auto &group : groups) {
+                if (group->clearOutputWindow != groups.front()->clearOutputWindow || group->redrawViewport != groups.front()->redrawViewport)
+                    throw MayaException(MStatus::kInvalidParameter,
+                                        "-clearOutputWindow and -redrawViewport must be the same for all export groups");
+            }
+
+            if (groups.front()->clearOutputWindow) {
+                OutputWindow().clear();
+            }
+
+            std::cout << prefix << "Starting export of " << groups.size() << " groups..." << endl;
+            exportScenes(groups);
         }
 
-        std::cout << prefix << "Starting export..." << endl;
-        exportScene(arguments);
-
         std::cout << prefix << "Finished export :-)" << endl;
         std::cout << "---------------------------------------------------------"
                      "-----------------------"
@@ -18,6 +18,9 @@ class Exporter : public MPxCommand {
 
     static void exportScene(const Arguments &args);
 
+    // Exports each group to its own output, sampling the animation clips of all groups in a single pass over the timeline.
+    static void exportScenes(const std::vector<std::unique_ptr<Arguments>> &groups);
+
   private:
     DISALLOW_COPY_MOVE_ASSIGN(Exporter);
     MStatus run(const MArgList &args) const;
@@ -43,6 +43,94 @@ MTransformationMatrix getTransformation(const MDagPath &path) {
     return fnMat.transformation();
 }
 
+namespace {
+// The transform attributes that contribute to the local transform of a DAG
+// node. Attributes that do not exist on the node are ignored.
+const char *const transformAttributeNames[] = {"translate",  "rotate",     "scale",       "shear",       "rotatePivot", "rotatePivotTranslate",
+                                               "scalePivot", "scalePivotTranslate", "rotateAxis", "rotateOrder", "jointOrient", "offsetParentMatrix"};
+
+bool isTimeDependentSource(const MObject &node) {
+    return node.hasFn(MFn::kAnimCurve) || node.hasFn(MFn::kExpression) || node.hasFn(MFn::kConstraint) ||
+           node.hasFn(MFn::kTime) || node.hasFn(MFn::kMotionPath) || node.hasFn(MFn::kIkHandle) ||
+           node.hasFn(MFn::kIkEffector) || node.hasFn(MFn::kCharacter) || node.hasFn(MFn::kDynBase) ||
+           node.hasFn(MFn::kNucleus) || node.hasFn(MFn::kCacheFile) || node.hasFn(MFn::kPluginDependNode) ||
+           node.hasFn(MFn::kPluginTransformNode);
+}
+
+bool hasTimeDependentInput(const MPlug &plug) {
+    MStatus status;
+
+    MPlugArray sources;
+    if (!plug.connectedTo(sources, true, false, &status) || sources.length() == 0)
+        return false;
+
+    for (unsigned i = 0; i < sources.length(); ++i) {
+        MObject sourceNode = sources[i].node();
+        if (isTimeDependentSource(sourceNode))
+            return true;
+
+        // Walk upstream from the source. This is conservative: any time
+        // dependent node that feeds the source makes the plug time dependent.
+        MItDependencyGraph it(sourceNode, MFn::kInvalid, MItDependencyGraph::kUpstream,
+                              MItDependencyGraph::kDepthFirst, MItDependencyGraph::kNodeLevel, &status);
+        THROW_ON_FAILURE(status);
+
+        for (; !it.isDone(); it.next()) {
+            if (isTimeDependentSource(it.currentItem()))
+                return true;
+        }
+    }
+
+    return false;
+}
+} // namespace
+
+bool isTimeDependent(const MPlug &plug) {
+    if (plug.isNull())
+        return false;
+
+    if (MAnimUtil::isAnimated(plug, true))
+        return true;
+
+    if (hasTimeDependentInput(plug))
+        return true;
+
+    for (unsigned i = 0; i < plug.numChildren(); ++i) {
+        if (isTimeDependent(plug.child(i)))
+            return true;
+    }
+
+    if (plug.isArray()) {
+        for (unsigned i = 0; i < plug.numElements(); ++i) {
+            if (isTimeDependent(plug.elementByPhysicalIndex(i)))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+bool hasTimeDependentLocalTransform(const MDagPath &dagPath) {
+    MStatus status;
+
+    if (MAnimUtil::isAnimated(dagPath, false))
+        return true;
+
+    MFnDependencyNode fnNode(dagPath.node(), &status);
+    THROW_ON_FAILURE(status);
+
+    if (isTimeDependentSource(fnNode.object()))
+        return true;
+
+    for (auto attributeName : transformAttributeNames) {
+        MPlug plug = fnNode.findPlug(attributeName, true, &status);
+        if (status && isTimeDependent(plug))
+            return true;
+    }
+
+    return false;
+}
+
 bool isNotSimpleChar(const char c) { return !isalnum(c); }
 
 MString simpleName(const MString &name) {
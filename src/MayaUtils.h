@@ -6,6 +6,15 @@ MMatrix getMatrix(const MFnDependencyNode &node, const char *plugName);
 
 MTransformationMatrix getTransformation(const MDagPath &path);
 
+// Returns true when the value of the plug, or one of its children, is driven
+// by something that can change over time: animation curves, expressions,
+// constraints, motion paths, IK, plugin nodes, ...
+bool isTimeDependent(const MPlug &plug);
+
+// Returns true when the local transform of the DAG node itself is driven by
+// something that can change over time, ignoring its ancestors.
+bool hasTimeDependentLocalTransform(const MDagPath &dagPath);
+
 // Return a string with all non-alpha-numeric characters replaced with an
 // underscore.
 MString simpleName(const MString &name);
@@ -7,6 +7,7 @@
 #include "MayaUtils.h"
 #include "Mesh.h"
 #include "MeshBlendShapeWeights.h"
+#include "ThreadPool.h"
 
 Mesh::Mesh(ExportableScene &scene, MDagPath dagPath,
            const ExportableNode &node) {
@@ -77,10 +78,76 @@ Mesh::Mesh(ExportableScene &scene, MDagPath dagPath,
             m_blendShapes.emplace_back(std::move(blendShape));
         }
     }
+
+    generateTangents(args);
 }
 
 Mesh::~Mesh() = default;
 
+void Mesh::generateTangents(const Arguments &args) {
+    if (args.mikkelsenTangentAngularThreshold <= 0)
+        return;
+
+    // Very large meshes are split into chunks of at least this many triangles
+    const size_t chunkTriangleCount = 1 << 16;
+
+    const auto shapeCount = m_allShapes.size();
+
+    std::vector<std::vector<std::vector<int>>> chunksPerShape(shapeCount);
+
+    auto &threadPool = ThreadPool::shared();
+
+    threadPool.parallelFor(shapeCount, [&](const size_t shapeIndex) {
+        chunksPerShape[shapeIndex] =
+            m_allShapes[shapeIndex]->vertices().mikkTSpaceChunks(
+                chunkTriangleCount);
+    });
+
+    struct TangentTask {
+        MeshVertices *vertices;
+        SetIndex setIndex;
+        const std::vector<int> *triangles;
+        std::unordered_set<int> invalidTriangleIndices;
+    };
+
+    std::vector<TangentTask> tasks;
+
+    for (size_t shapeIndex = 0; shapeIndex < shapeCount; ++shapeIndex) {
+        auto &vertices = m_allShapes[shapeIndex]->vertices();
+        for (auto setIndex : vertices.mikkTSpaceSetIndices()) {
+            for (auto &triangles : chunksPerShape[shapeIndex]) {
+                tasks.push_back({&vertices, setIndex, &triangles, {}});
+            }
+        }
+    }
+
+    threadPool.parallelFor(tasks.size(), [&](const size_t taskIndex) {
+        auto &task = tasks[taskIndex];
+        task.vertices->generateMikkTSpaceTangents(
+            task.setIndex, span(*task.triangles),
+            args.mikkelsenTangentAngularThreshold,
+            task.invalidTriangleIndices);
+    });
+
+    // Report the invalid triangles per shape and tangent set, in order.
+    for (size_t taskIndex = 0; taskIndex < tasks.size();) {
+        auto &first = tasks[taskIndex];
+
+        auto invalidTriangleIndices = std::move(first.invalidTriangleIndices);
+
+        for (++taskIndex; taskIndex < tasks.size() &&
+               tasks[taskIndex].vertices == first.vertices &&
+               tasks[taskIndex].setIndex == first.setIndex;
+             ++taskIndex) {
+            auto &indices = tasks[taskIndex].invalidTriangleIndices;
+            invalidTriangleIndices.insert(indices.begin(), indices.end());
+        }
+
+        first.vertices->reportInvalidMikkTSpaceTriangles(
+            invalidTriangleIndices);
+    }
+}
+
 MObject
 Mesh::tryExtractBlendShapeDeformer(const MFnMesh &fnMesh,
                                    const MSelectionList &ignoredDeformers) {
@@ -36,6 +36,10 @@ class Mesh {
     MObject getOrCreateOutputShape(MPlug &outputGeometryPlug,
                                    MObject &createdMesh) const;
 
+    // Generates the MikkTSpace tangents of all shapes and tangent sets on the
+    // worker threads, after all Maya data is copied.
+    void generateTangents(const Arguments &args);
+
     static MObject
     tryExtractBlendShapeDeformer(const MFnMesh &fnMesh,
                                  const MSelectionList &ignoredDeformers);
@@ -32,12 +32,18 @@ MeshIndices::MeshIndices(const MeshSemantics *meshSemantics,
         m_TriangleCount += triangleCount;
     }
 
+    // The indices of the vertex joint assignments are the same as the points.
+    m_positionAliases.set(Semantic::WEIGHTS);
+    m_positionAliases.set(Semantic::JOINTS);
+
     for (auto kind = 0; kind < Semantic::COUNT; ++kind) {
         auto &indexSet = m_table.at(kind);
         const auto n = semantics.descriptions(Semantic::from(kind)).size();
         for (auto set = 0U; set < n; ++set) {
             IndexVector indices;
-            indices.reserve(m_TriangleCount * 3);
+            if (!aliasesPositionIndices(kind)) {
+                indices.reserve(m_TriangleCount * 3);
+            }
             indexSet.push_back(indices);
         }
     }
@@ -174,22 +180,21 @@ MeshIndices::MeshIndices(const MeshSemantics *meshSemantics,
             }
         }
     }
-
-    // The indices of the vertex joint assignments are the same as the points.
-    // TODO: We should use spans instead of copying the vectors...
-    auto &vertexJointWeightsSets = m_table.at(Semantic::WEIGHTS);
-    for (auto &set : vertexJointWeightsSets) {
-        set = positions;
-    }
-
-    auto &vertexJointIndicesSets = m_table.at(Semantic::JOINTS);
-    for (auto &set : vertexJointIndicesSets) {
-        set = positions;
-    }
 }
 
 MeshIndices::~MeshIndices() = default;
 
 void MeshIndices::dump(IndentableStream &out, const std::string &name) const {
-    dump_index_table(out, name, m_table, perPrimitiveVertexCount());
+    // Dump the aliased index vectors too, like all other sets
+    auto table = m_table;
+
+    for (auto kind = 0; kind < Semantic::COUNT; ++kind) {
+        if (aliasesPositionIndices(kind)) {
+            for (auto &indices : table.at(kind)) {
+                indices = indicesAt(Semantic::POSITION, 0);
+            }
+        }
+    }
+
+    dump_index_table(out, name, table, perPrimitiveVertexCount());
 }
@@ -44,6 +44,8 @@ class MeshIndices {
     MeshIndices(const MeshSemantics *meshSemantics, const MFnMesh &fnMesh);
     virtual ~MeshIndices();
 
+    // The index vectors of semantics that alias the point indices are empty,
+    // use indicesAt to get these.
     const VertexElementIndicesPerSetIndexTable &table() const {
         return m_table;
     }
@@ -59,9 +61,19 @@ class MeshIndices {
         return perPrimitiveVertexCount() * primitiveCount();
     }
 
+    // Do all sets of the semantic use the point indices?
+    // This is the case for the skin weights and joints, these don't get a
+    // copy of the point indices.
+    bool aliasesPositionIndices(const size_t semanticIndex) const {
+        return m_positionAliases.test(semanticIndex);
+    }
+
     const IndexVector &indicesAt(const size_t semanticIndex,
                                  const size_t setIndex) const {
-        return m_table.at(semanticIndex).at(setIndex);
+        assert(setIndex < m_table.at(semanticIndex).size());
+        return aliasesPositionIndices(semanticIndex)
+                   ? m_table.at(Semantic::POSITION).at(0)
+                   : m_table.at(semanticIndex).at(setIndex);
     }
 
     FaceIndex triangleToFaceIndex(TriangleIndex triangleIndex) const {
@@ -77,6 +89,7 @@ class MeshIndices {
   private:
     int m_TriangleCount;
     VertexElementIndicesPerSetIndexTable m_table;
+    std::bitset<Semantic::COUNT> m_positionAliases;
     MeshShadingPerInstance m_shadingPerInstance;
     TriangleToFaceIndexMap m_triangleToFaceIndexMap;
 
@@ -6,13 +6,13 @@
 #include "MeshIndices.h"
 #include "MeshRenderables.h"
 #include "MeshVertices.h"
+#include "kernels.h"
 using namespace coveo::linq;
 
 MeshRenderables::MeshRenderables(const MeshShapes &meshShapes,
+                                 const InstanceNumber instanceNumber,
                                  const Arguments &args)
-    : instanceNumber(meshShapes.at(0)->instanceNumber()) {
-    MStatus status;
-
+    : instanceNumber(instanceNumber) {
     const auto &mainShape = dynamic_cast<MainShape *>(meshShapes.at(0));
     const auto &mainIndices = mainShape->indices();
     const auto &mainVertices = mainShape->vertices();
@@ -41,6 +41,41 @@ MeshRenderables::MeshRenderables(const MeshShapes &meshShapes,
     auto totalWeldCount = 0;
     auto totalVertexCount = 0;
 
+    // Reused for all vertices, to avoid allocations when there are more than
+    // 64 slots
+    VertexSignature vertexSignature(0);
+
+    // Resolve the index vector of each slot once, in the order of the vertex
+    // signature bits. The skin weights and joints alias the point indices, so
+    // these share the same vector.
+    struct SlotIndices {
+        Semantic::Kind semantic;
+        int setIndex;
+        const IndexVector *indices;
+    };
+
+    std::vector<std::vector<SlotIndices>> slotIndicesPerShape(meshShapes.size());
+
+    for (auto shapeIndex = 0U; shapeIndex < meshShapes.size(); ++shapeIndex) {
+        const auto &shapeVerticesTable =
+            meshShapes.at(shapeIndex)->vertices().table();
+
+        for (auto semanticIndex = 0U; semanticIndex < shapeVerticesTable.size();
+             ++semanticIndex) {
+            if (!shapeVerticesTable.at(semanticIndex).empty() &&
+                semanticsMask.test(semanticIndex)) {
+                const auto setCount =
+                    static_cast<int>(mainIndicesTable.at(semanticIndex).size());
+
+                for (auto setIndex = 0; setIndex < setCount; ++setIndex) {
+                    slotIndicesPerShape[shapeIndex].push_back(
+                        {Semantic::from(semanticIndex), setIndex,
+                         &mainIndices.indicesAt(semanticIndex, setIndex)});
+                }
+            }
+        }
+    }
+
     for (auto primitiveIndex = 0; primitiveIndex < primitiveCount;
          ++primitiveIndex) {
         const auto shaderIndex =
@@ -50,7 +85,8 @@ MeshRenderables::MeshRenderables(const MeshShapes &meshShapes,
              ++primitiveVertexIndex) {
             // Compute the vertex signature (one bit per semantic+set, 0=unused,
             // 1=used)
-            VertexSignature vertexSignature(shaderIndex, 0);
+            vertexSignature.shaderIndex = shaderIndex;
+            vertexSignature.slotUsage.clear();
 
             vertexLayout.clear();
             vertexIndexKey.clear();
@@ -60,44 +96,26 @@ MeshRenderables::MeshRenderables(const MeshShapes &meshShapes,
                 auto &shape = meshShapes.at(shapeIndex);
                 const auto &shapeVerticesTable = shape->vertices().table();
 
-                for (auto semanticIndex = 0U;
-                     semanticIndex < shapeVerticesTable.size();
-                     ++semanticIndex) {
-                    if (!shapeVerticesTable.at(semanticIndex).empty() &&
-                        semanticsMask.test(semanticIndex)) {
-                        const auto &indicesPerSet =
-                            mainIndicesTable.at(semanticIndex);
-
-                        for (auto setIndex = 0; setIndex < indicesPerSet.size();
-                             ++setIndex) {
-                            const auto &indices = indicesPerSet.at(setIndex);
-                            const auto index = indices[primitiveVertexIndex];
-                            const int isUsed = index >= 0;
-                            vertexSignature.slotUsage <<= 1;
-                            vertexSignature.slotUsage |= isUsed;
-                            if (isUsed) {
-                                auto semantic = Semantic::from(semanticIndex);
-                                vertexLayout.emplace_back(
-                                    ShapeIndex::shape(shapeIndex), semantic,
-                                    setIndex);
-
-                                const auto &elementIndices =
-                                    indicesPerSet.at(setIndex);
-                                const auto vertexIndex =
-                                    elementIndices.at(primitiveVertexIndex);
-                                const auto &vertexElements =
-                                    shapeVerticesTable.at(semantic).at(
-                                        setIndex);
-                                const auto &sourceComponents =
-                                    componentsAt(vertexElements, vertexIndex,
-                                                 semantic, shape->shapeIndex);
-                                const auto sourceBytes =
-                                    sourceComponents.bytes();
-                                vertexIndexKey.insert(vertexIndexKey.end(),
-                                                      sourceBytes.begin(),
-                                                      sourceBytes.end());
-                            }
-                        }
+                for (auto &&slotIndices : slotIndicesPerShape[shapeIndex]) {
+                    const auto semantic = slotIndices.semantic;
+                    const auto setIndex = slotIndices.setIndex;
+                    const auto vertexIndex =
+                        (*slotIndices.indices)[primitiveVertexIndex];
+                    const int isUsed = vertexIndex >= 0;
+                    vertexSignature.slotUsage.push(isUsed);
+                    if (isUsed) {
+                        vertexLayout.emplace_back(ShapeIndex::shape(shapeIndex),
+                                                  semantic, setIndex);
+
+                        const auto &vertexElements =
+                            shapeVerticesTable.at(semantic).at(setIndex);
+                        const auto &sourceComponents =
+                            componentsAt(vertexElements, vertexIndex, semantic,
+                                         shape->shapeIndex);
+                        const auto sourceBytes = sourceComponents.bytes();
+                        vertexIndexKey.insert(vertexIndexKey.end(),
+                                              sourceBytes.begin(),
+                                              sourceBytes.end());
                     }
                 }
             }
@@ -155,10 +173,9 @@ MeshRenderables::MeshRenderables(const MeshShapes &meshShapes,
         }
     }
 
-    cout << prefix << mainShape->dagPath().partialPathName().asChar()
-         << " will have " << maxVertexCount - totalWeldCount
-         << " vertices. Welded#" << totalWeldCount << ", min#" << minVertexCount
-         << ", max#" << maxVertexCount << endl;
+    m_weldCount = totalWeldCount;
+    m_minVertexCount = minVertexCount;
+    m_maxVertexCount = maxVertexCount;
 
     // Now compute the blend-shape vector-deltas by subtracting the
     // blend-shape-base mesh from the blend-shape-targets
@@ -174,31 +191,28 @@ MeshRenderables::MeshRenderables(const MeshShapes &meshShapes,
                     const VertexSlot mainSlot(ShapeIndex::main(),
                                               targetSlot.semantic,
                                               targetSlot.setIndex);
-                    auto sourceComponents =
-                        reinterpret_span<float>(compMap.at(mainSlot));
-                    auto targetComponents = mutable_span(
-                        reinterpret_span<float>(slotCompPair.second));
+                    auto &sourceData = compMap.at(mainSlot);
+                    auto &targetData = slotCompPair.second;
 
-                    // The annoying fact that TANGENTs have dimension 4 in the
-                    // main shape and 3 in the targets requires this hacky code.
+                    // TANGENTs have dimension 4 in the main shape and 3 in
+                    // the targets, the kernel only subtracts the shared
+                    // components.
                     const auto sourceDimension = mainSlot.dimension();
                     const auto targetDimension = targetSlot.dimension();
-                    const auto sharedDimension =
-                        std::min(sourceDimension, targetDimension);
-                    const auto sourceComponentCount = sourceComponents.size();
-                    const auto targetComponentCount = targetComponents.size();
-                    assert(sourceComponentCount / sourceDimension ==
-                           targetComponentCount / targetDimension);
-
-                    for (size_t sourceIndex = 0U, targetIndex = 0U;
-                         sourceIndex < size_t(sourceComponentCount);
-                         sourceIndex += sourceDimension,
-                                targetIndex += targetDimension) {
-                        for (size_t dimension = 0; dimension < sharedDimension;
-                             ++dimension) {
-                            targetComponents[targetIndex + dimension] -=
-                                sourceComponents[sourceIndex + dimension];
-                        }
+                    const auto elementCount =
+                        targetData.size() / targetSlot.elementByteSize();
+                    assert(sourceData.size() / mainSlot.elementByteSize() ==
+                           elementCount);
+
+                    const auto maxAbsDelta = kernels::subtractDeltas(
+                        reinterpret_cast<const float *>(sourceData.data()),
+                        sourceDimension,
+                        reinterpret_cast<float *>(targetData.data()),
+                        targetDimension, elementCount);
+
+                    // Most targets only move some primitives of a mesh
+                    if (maxAbsDelta == 0) {
+                        buffer.zeroDeltaSlots.insert(targetSlot);
                     }
                 }
             }
@@ -208,11 +222,23 @@ MeshRenderables::MeshRenderables(const MeshShapes &meshShapes,
 
 MeshRenderables::~MeshRenderables() = default;
 
+std::ostream &operator<<(std::ostream &out, const VertexSlotUsage &obj) {
+    const auto flags = out.flags();
+    const auto fill = out.fill();
+    out << std::hex;
+    for (auto it = obj.m_overflowBits.rbegin(); it != obj.m_overflowBits.rend();
+         ++it) {
+        out << std::setw(16) << std::setfill('0') << *it << ':';
+    }
+    out << std::setfill(fill) << std::setw(8) << obj.m_bits;
+    out.flags(flags);
+    return out;
+}
+
 std::ostream &operator<<(std::ostream &out, const VertexSignature &obj) {
     out << '{' << ' ';
     out << std::quoted("shaderIndex") << ':' << obj.shaderIndex << ',';
-    out << std::quoted("slotUsage") << ':' << std::hex << std::setw(8)
-        << obj.slotUsage;
+    out << std::quoted("slotUsage") << ':' << obj.slotUsage;
     out << ' ' << '}';
     return out;
 }
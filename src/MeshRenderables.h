@@ -8,8 +8,74 @@ class Arguments;
 
 typedef int VertexIndex;
 
-// TODO: We currently do not support more than 64 slots per vertex.
-typedef uint64_t VertexSlotUsage;
+/**
+ * A bit per vertex slot, shifted in like a shift register, so the last 64
+ * slots are stored inline, like a plain 64-bit integer. The bits of older
+ * slots are only stored when a vertex has more than 64 slots, e.g. for many
+ * blend shape targets, so these are not lost.
+ */
+class VertexSlotUsage {
+  public:
+    DEFAULT_COPY_MOVE_ASSIGN_CTOR_DTOR(VertexSlotUsage);
+
+    void clear() {
+        m_bits = 0;
+        m_slotCount = 0;
+        m_overflowBits.clear();
+    }
+
+    void push(const bool isUsed) {
+        if (m_slotCount >= 64) {
+            // Keep the bit that is shifted out
+            const auto overflowIndex = m_slotCount - 64;
+            if (overflowIndex % 64 == 0) {
+                m_overflowBits.push_back(0);
+            }
+            m_overflowBits.back() |= (m_bits >> 63) << (overflowIndex % 64);
+        }
+
+        m_bits = (m_bits << 1) | static_cast<uint64_t>(isUsed);
+        ++m_slotCount;
+    }
+
+    size_t slotCount() const { return m_slotCount; }
+
+    friend bool operator==(const VertexSlotUsage &lhs,
+                           const VertexSlotUsage &rhs) {
+        return lhs.m_bits == rhs.m_bits && lhs.m_slotCount == rhs.m_slotCount &&
+               lhs.m_overflowBits == rhs.m_overflowBits;
+    }
+
+    friend bool operator!=(const VertexSlotUsage &lhs,
+                           const VertexSlotUsage &rhs) {
+        return !(lhs == rhs);
+    }
+
+    friend bool operator<(const VertexSlotUsage &lhs,
+                          const VertexSlotUsage &rhs) {
+        return std::tie(lhs.m_slotCount, lhs.m_overflowBits, lhs.m_bits) <
+               std::tie(rhs.m_slotCount, rhs.m_overflowBits, rhs.m_bits);
+    }
+
+    // The same as the hash of the 64-bit integer when there are at most 64
+    // slots
+    friend std::size_t hash_value(const VertexSlotUsage &obj) {
+        auto seed = static_cast<std::size_t>(obj.m_bits);
+        for (auto bits : obj.m_overflowBits) {
+            seed ^= (seed << 6) + (seed >> 2) + 0x2F0B3A49 +
+                    static_cast<std::size_t>(bits);
+        }
+        return seed;
+    }
+
+    friend std::ostream &operator<<(std::ostream &out,
+                                    const VertexSlotUsage &obj);
+
+  private:
+    uint64_t m_bits = 0;
+    size_t m_slotCount = 0;
+    std::vector<uint64_t> m_overflowBits;
+};
 
 struct VertexSignature {
     ShaderIndex shaderIndex;
@@ -24,8 +90,8 @@ struct VertexSignature {
      */
 
     explicit VertexSignature(const ShaderIndex shaderIndex,
-                             const VertexSlotUsage slotUsage)
-        : shaderIndex(shaderIndex), slotUsage(slotUsage) {}
+                             VertexSlotUsage slotUsage = {})
+        : shaderIndex(shaderIndex), slotUsage(std::move(slotUsage)) {}
 
     DEFAULT_COPY_MOVE_ASSIGN_DTOR(VertexSignature);
 
@@ -66,7 +132,7 @@ struct VertexSignature {
         seed ^= (seed << 6) + (seed >> 2) + 0x79FBC802 +
                 static_cast<std::size_t>(obj.shaderIndex);
         seed ^= (seed << 6) + (seed >> 2) + 0x5A1BB057 +
-                static_cast<std::size_t>(obj.slotUsage);
+                hash_value(obj.slotUsage);
         return seed;
     }
 
@@ -179,12 +245,20 @@ typedef std::unordered_map<VertexElementData, Index, VertexHashers>
 typedef std::unordered_map<VertexSlot, VertexElementData, VertexHashers>
     VertexElementsMap;
 
+typedef std::unordered_set<VertexSlot, VertexHashers> VertexSlotSet;
+
 struct VertexBuffer {
     VertexToIndexMapping vertexToIndexMapping;
     IndexVector indices;
     VertexElementsMap componentsMap;
 
-    size_t maxIndex() const { return vertexToIndexMapping.size(); };
+    // The blend shape slots whose deltas are all zero
+    VertexSlotSet zeroDeltaSlots;
+
+    // The number of vertices of a buffer without vertex to index mapping, e.g. a copy or a merged buffer
+    size_t vertexCount = 0;
+
+    size_t maxIndex() const { return std::max(vertexToIndexMapping.size(), vertexCount); };
 };
 
 typedef std::unordered_map<VertexSignature, VertexBuffer, VertexHashers>
@@ -192,7 +266,9 @@ typedef std::unordered_map<VertexSignature, VertexBuffer, VertexHashers>
 
 class MeshRenderables {
   public:
-    MeshRenderables(const MeshShapes &meshShapes, const Arguments &args);
+    // Doesn't use Maya, so this can run on a worker thread
+    MeshRenderables(const MeshShapes &meshShapes, InstanceNumber instanceNumber,
+                    const Arguments &args);
 
     ~MeshRenderables();
 
@@ -200,7 +276,14 @@ class MeshRenderables {
 
     const VertexBufferTable &table() const { return m_table; }
 
+    size_t weldCount() const { return m_weldCount; }
+    size_t minVertexCount() const { return m_minVertexCount; }
+    size_t maxVertexCount() const { return m_maxVertexCount; }
+
   protected:
     DISALLOW_COPY_MOVE_ASSIGN(MeshRenderables);
     VertexBufferTable m_table;
+    size_t m_weldCount = 0;
+    size_t m_minVertexCount = 0;
+    size_t m_maxVertexCount = 0;
 };
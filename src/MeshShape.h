@@ -26,6 +26,7 @@ class MeshShape {
     const MDagPath &dagPath() const { return m_dagPath; }
     const MeshSemantics &semantics() const { return *m_semantics; }
     const MeshVertices &vertices() const { return *m_vertices; }
+    MeshVertices &vertices() { return *m_vertices; }
 
     size_t instanceNumber() const;
 
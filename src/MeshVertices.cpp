@@ -9,20 +9,29 @@
 #include "MeshSkeleton.h"
 #include "MeshVertices.h"
 #include "dump.h"
+#include "kernels.h"
 #include "mikktspace.h"
 #include "spans.h"
 
+struct PositionHasher {
+    std::size_t operator()(const Position &position) const {
+        // Adding zero turns -0 into 0, these are equal positions
+        const Position key{position[0] + 0.0f, position[1] + 0.0f, position[2] + 0.0f};
+        return hash_value(reinterpret_span<ushort>(gsl::make_span(key)));
+    }
+};
+
 struct MikkTSpaceIndices {
     gsl::span<const Index> positions;
     gsl::span<const Index> normals;
     gsl::span<const Index> texcoords;
-    gsl::span<Index> tangents;
+    gsl::span<const Index> tangents;
 
     MikkTSpaceIndices(const MeshIndices &meshIndices, const int setIndex) {
         positions = gsl::make_span(meshIndices.indicesAt(Semantic::POSITION, 0));
         normals = gsl::make_span(meshIndices.indicesAt(Semantic::NORMAL, 0));
         texcoords = gsl::make_span(meshIndices.indicesAt(Semantic::TEXCOORD, setIndex));
-        tangents = mutable_span(gsl::make_span(meshIndices.indicesAt(Semantic::TANGENT, setIndex)));
+        tangents = gsl::make_span(meshIndices.indicesAt(Semantic::TANGENT, setIndex));
     }
 };
 
@@ -48,6 +57,8 @@ struct MikkTSpaceVectors {
 struct MikkTSpaceContext : SMikkTSpaceContext {
     const size_t triangleCount;
     const ShapeIndex shapeIndex;
+    // The triangles to generate tangents for, all when empty
+    const gsl::span<const int> triangles;
     MikkTSpaceIndices indices;
     MikkTSpaceVectors vectors;
     SMikkTSpaceInterface interface;
@@ -58,9 +69,10 @@ struct MikkTSpaceContext : SMikkTSpaceContext {
     mutable std::unordered_set<int> invalidTriangleIndices;
 
     MikkTSpaceContext(const MeshIndices &meshIndices, VertexElementsPerSetIndexTable &vertexTable, const int setIndex,
-                      const ShapeIndex &shapeIndex)
-        : SMikkTSpaceContext{}, triangleCount(meshIndices.primitiveCount()), shapeIndex(shapeIndex),
-          indices(meshIndices, setIndex), vectors(meshIndices, vertexTable, setIndex), interface{} {
+                      const ShapeIndex &shapeIndex, const gsl::span<const int> &triangles)
+        : SMikkTSpaceContext{}, triangleCount(triangles.empty() ? meshIndices.primitiveCount() : triangles.size()),
+          shapeIndex(shapeIndex), triangles(triangles), indices(meshIndices, setIndex),
+          vectors(meshIndices, vertexTable, setIndex), interface{} {
         m_pInterface = &interface;
         m_pUserData = this;
 
@@ -86,11 +98,13 @@ struct MikkTSpaceContext : SMikkTSpaceContext {
         return static_cast<int>(count);
     }
 
+    int triangleIndex(const int iFace) const { return triangles.empty() ? iFace : triangles[iFace]; }
+
     static int getNumVerticesOfFace(const SMikkTSpaceContext *pContext, const int iFace) { return 3; }
 
     static void getPosition(const SMikkTSpaceContext *pContext, float fvPosOut[], const int iFace, const int iVert) {
         const auto context = reinterpret_cast<const MikkTSpaceContext *>(pContext);
-        const auto index = context->indices.positions[iFace * 3 + iVert];
+        const auto index = context->indices.positions[context->triangleIndex(iFace) * 3 + iVert];
         const auto &vector = context->vectors.positions[index];
         fvPosOut[0] = vector[0];
         fvPosOut[1] = vector[1];
@@ -99,7 +113,7 @@ struct MikkTSpaceContext : SMikkTSpaceContext {
 
     static void getNormal(const SMikkTSpaceContext *pContext, float fvNormOut[], const int iFace, const int iVert) {
         const auto context = reinterpret_cast<const MikkTSpaceContext *>(pContext);
-        const auto index = context->indices.normals[iFace * 3 + iVert];
+        const auto index = context->indices.normals[context->triangleIndex(iFace) * 3 + iVert];
         const auto &vector = context->vectors.normals[index];
         fvNormOut[0] = vector[0];
         fvNormOut[1] = vector[1];
@@ -108,7 +122,7 @@ struct MikkTSpaceContext : SMikkTSpaceContext {
 
     static void getTexCoord(const SMikkTSpaceContext *pContext, float fvTexcOut[], const int iFace, const int iVert) {
         const auto context = reinterpret_cast<const MikkTSpaceContext *>(pContext);
-        const auto index = context->indices.texcoords[iFace * 3 + iVert];
+        const auto index = context->indices.texcoords[context->triangleIndex(iFace) * 3 + iVert];
 
         if (index < 0) {
             fvTexcOut[0] = NAN;
@@ -124,20 +138,18 @@ struct MikkTSpaceContext : SMikkTSpaceContext {
                                const int iFace, const int iVert) {
         const auto context = reinterpret_cast<const MikkTSpaceContext *>(pContext);
 
-        // Re-index
-        const auto index = iFace * 3 + iVert;
-        auto &tangentIndexRef = context->indices.tangents[index];
-
-        // If the vertex doesn't have a tangent, don't assign one
-        if (tangentIndexRef >= 0) {
-            tangentIndexRef = index;
+        const auto triangleIndex = context->triangleIndex(iFace);
+        const auto index = triangleIndex * 3 + iVert;
 
+        // If the vertex doesn't have a tangent, don't assign one.
+        // The tangent indices were already re-indexed when the Maya data was copied.
+        if (context->indices.tangents[index] >= 0) {
             const float tx = fvTangent[0];
             const float ty = fvTangent[1];
             const float tz = fvTangent[2];
 
             if (tx == 0 && ty == 0 && tz == 0) {
-                context->invalidTriangleIndices.insert(iFace);
+                context->invalidTriangleIndices.insert(triangleIndex);
             }
 
             if (context->shapeIndex.isMainShapeIndex()) {
@@ -157,13 +169,13 @@ struct MikkTSpaceContext : SMikkTSpaceContext {
 
     static void reportDegenerateTriangle(const SMikkTSpaceContext *pContext, int triangleIndex) {
         const auto context = reinterpret_cast<const MikkTSpaceContext *>(pContext);
-        context->invalidTriangleIndices.insert(triangleIndex);
+        context->invalidTriangleIndices.insert(context->triangleIndex(triangleIndex));
     }
 };
 
 MeshVertices::MeshVertices(const MeshIndices &meshIndices, const MeshSkeleton *meshSkeleton, const MFnMesh &mesh,
                            ShapeIndex shapeIndex, const ExportableNode &node, const Arguments &args)
-    : shapeIndex(shapeIndex) {
+    : shapeIndex(shapeIndex), m_meshIndices(meshIndices), m_meshName(mesh.name()) {
     MStatus status;
 
     auto &semantics = meshIndices.semantics;
@@ -178,20 +190,23 @@ MeshVertices::MeshVertices(const MeshIndices &meshIndices, const MeshSkeleton *m
     }
 
     // Get points
-    MPointArray mPoints;
+    // Maya stores these as floats, so the float points are the same as the double ones.
+    MFloatPointArray mPoints;
     THROW_ON_FAILURE(input_mesh.getPoints(mPoints, MSpace::kTransform));
     const int numPoints = mPoints.length();
-    m_positions.reserve(numPoints);
+    m_positions.resize(numPoints);
 
-    const auto positionScale = args.getBakeScaleFactor();
+    const auto points = span(mPoints);
     for (int i = 0; i < numPoints; ++i) {
-        const auto p = mPoints[i] * positionScale;
-        m_positions.push_back(
-            {roundToFloat(p.x, args.posPrecision), 
-             roundToFloat(p.y, args.posPrecision), 
-             roundToFloat(p.z, args.posPrecision)});
+        const auto &p = points[i];
+        m_positions[i] = {p.x, p.y, p.z};
     }
 
+    const auto positionScale = args.getBakeScaleFactor();
+    auto *positionComponents = reinterpret_cast<float *>(m_positions.data());
+    kernels::scaleRoundToFloats(positionComponents, positionComponents, numPoints * array_size<Position>::size,
+                                positionScale, args.posPrecision);
+
     const auto positionsSpan = floats(span(m_positions));
     m_table.at(Semantic::POSITION).push_back(positionsSpan);
     
@@ -209,13 +224,11 @@ MeshVertices::MeshVertices(const MeshIndices &meshIndices, const MeshSkeleton *m
     MFloatVectorArray mNormals;
     THROW_ON_FAILURE(input_mesh.getNormals(mNormals, MSpace::kWorld));
     const int numNormals = mNormals.length();
-    m_normals.reserve(numNormals);
-    for (int i = 0; i < numNormals; ++i) {
-        auto n = mNormals[i];
-        m_normals.push_back({roundToFloat(normalSign * n.x, args.dirPrecision), 
-                             roundToFloat(normalSign * n.y, args.dirPrecision),
-                             roundToFloat(normalSign * n.z, args.dirPrecision)});
-    }
+    m_normals.resize(numNormals);
+
+    const auto normalComponents = reinterpret_span<float>(span(mNormals));
+    kernels::scaleRoundToFloats(normalComponents.data(), reinterpret_cast<float *>(m_normals.data()),
+                                normalComponents.size(), normalSign, args.dirPrecision);
 
     const auto normalsSpan = floats(span(m_normals));
     m_table.at(Semantic::NORMAL).push_back(normalsSpan);
@@ -229,15 +242,11 @@ MeshVertices::MeshVertices(const MeshIndices &meshIndices, const MeshSkeleton *m
         THROW_ON_FAILURE(status);
 
         auto &colors = m_colorSets[semantic.setIndex];
-        colors.reserve(numColors);
-        for (int i = 0; i < numColors; ++i) {
-            const auto &c = mColors[i];
-            ;
-            colors.push_back({roundToFloat(c.r, args.colPrecision), 
-                              roundToFloat(c.g, args.colPrecision),
-                              roundToFloat(c.b, args.colPrecision), 
-                              roundToFloat(c.a, args.colPrecision)});
-        }
+        colors.resize(numColors);
+
+        const auto colorComponents = reinterpret_span<float>(span(mColors));
+        kernels::scaleRoundToFloats(colorComponents.data(), reinterpret_cast<float *>(colors.data()),
+                                    colorComponents.size(), 1, args.colPrecision);
 
         const auto colorsSpan = floats(span(colors));
         m_table.at(Semantic::COLOR).push_back(colorsSpan);
@@ -254,16 +263,18 @@ MeshVertices::MeshVertices(const MeshIndices &meshIndices, const MeshSkeleton *m
         const int uCount = uArray.length();
 
         auto &uvSet = m_uvSets[semantic.setIndex] = Float2Vector(uCount);
-        for (auto uIndex = 0; uIndex < uCount; uIndex++) {
-            auto &uvArray = uvSet[uIndex];
-            uvArray[0] = roundToFloat(uArray[uIndex], args.texPrecision);
-            uvArray[1] = roundToFloat(1 - vArray[uIndex], args.texPrecision);
-        }
+        auto *uvComponents = reinterpret_cast<float *>(uvSet.data());
+        kernels::interleaveFlippedUVs(span(uArray).data(), span(vArray).data(), uvComponents, uCount);
+        kernels::scaleRoundToFloats(uvComponents, uvComponents, uCount * array_size<TexCoord>::size, 1,
+                                    args.texPrecision);
 
         const auto uvSpan = floats(span(uvSet));
         m_table.at(Semantic::TEXCOORD).push_back(uvSpan);
     }
 
+    // The normals used to compute the handedness of Maya's tangents, fetched on first use
+    MFloatVectorArray mTangentSpaceNormals;
+
     // Get tangent sets
     for (auto &&semantic : semantics.descriptions(Semantic::TANGENT)) {
         if (args.mikkelsenTangentAngularThreshold > 0) {
@@ -276,28 +287,17 @@ MeshVertices::MeshVertices(const MeshIndices &meshIndices, const MeshSkeleton *m
             const auto tangentSpan = floats(span(tangentSet));
             m_table.at(Semantic::TANGENT).push_back(tangentSpan);
 
-            MikkTSpaceContext context(meshIndices, m_table, semantic.setIndex, shapeIndex);
-            context.computeTangents(args.mikkelsenTangentAngularThreshold);
-
-            if (!context.invalidTriangleIndices.empty()) {
-                // Don't flood the console output if too many faces are invalid.
-                int maxIndices = 10;
-
-                std::stringstream ss;
-                ss << "select -r";
-                for (auto triangleIndex : context.invalidTriangleIndices) {
-                    ss << ' ' << mesh.name() << ".f[" << meshIndices.triangleToFaceIndex(triangleIndex) << "]";
-                    if (--maxIndices < 0)
-                        break;
+            // MikkTSpace generates a tangent per face-vertex, unless the vertex doesn't have a tangent.
+            // The blend shapes share these indices, so re-index them here, not on the threads generating the tangents.
+            auto tangentIndices = mutable_span(gsl::make_span(meshIndices.indicesAt(Semantic::TANGENT, semantic.setIndex)));
+            for (int index = 0; index < numTangents; ++index) {
+                if (tangentIndices[index] >= 0) {
+                    tangentIndices[index] = index;
                 }
-                ss << ";";
-
-                MayaException::printError(formatted("Tangent generator found degenerate faces!\nThis can cause "
-                                                    "rendering artifacts.\nPlease check and fix your mesh and "
-                                                    "UV mapping.\nUse the following command select the first "
-                                                    "invalid faces:\n%s\n\n",
-                                                    ss.str().c_str()));
             }
+
+            // The tangents are generated once all Maya data of the mesh is copied, see generateMikkTSpaceTangents
+            m_mikkTSpaceSetIndices.push_back(semantic.setIndex);
         } else {
             MFloatVectorArray mTangents;
 
@@ -312,26 +312,86 @@ MeshVertices::MeshVertices(const MeshIndices &meshIndices, const MeshSkeleton *m
             } else {
                 const int numTangents = mTangents.length();
 
-                auto &tangentSet = m_tangentSets[semantic.setIndex];
-                tangentSet.reserve(numTangents * dimension(Semantic::TANGENT, shapeIndex));
+                std::vector<Float3> tangents(numTangents);
+                THROW_ON_FAILURE(mTangents.get(reinterpret_cast<float(*)[3]>(tangents.data())));
 
-                std::unordered_set<int> invalidTangentIds;
+                // Only the tangents of the main shape have a handedness
+                std::vector<float> handedness;
 
-                for (int i = 0; i < numTangents; ++i) {
-                    auto t = mTangents[i];
-                    const auto rht = 2 * mesh.isRightHandedTangent(i, &semantic.setName, &status) - 1.0f;
-                    THROW_ON_FAILURE(status);
-                    tangentSet.push_back(roundToFloat(t.x, args.dirPrecision));
-                    tangentSet.push_back(roundToFloat(t.y, args.dirPrecision));
-                    tangentSet.push_back(roundToFloat(t.z, args.dirPrecision));
+                if (shapeIndex.isMainShapeIndex()) {
+                    handedness.resize(numTangents, 1.0f);
+
+                    // Fetch all data in bulk, instead of asking Maya for the handedness of each tangent
+                    MFloatVectorArray mBinormals;
+                    THROW_ON_FAILURE(mesh.getBinormals(mBinormals, MSpace::kWorld, &semantic.setName));
 
-                    auto l = t.x * t.x + t.y * t.y + t.z * t.z;
-                    if (abs(l - 1) > 1e-6) {
-                        invalidTangentIds.insert(i);
+                    if (mTangentSpaceNormals.length() == 0) {
+                        THROW_ON_FAILURE(mesh.getNormals(mTangentSpaceNormals, MSpace::kWorld));
                     }
 
-                    if (shapeIndex.isMainShapeIndex()) {
-                        tangentSet.push_back(rht);
+                    std::vector<Float3> binormals(mBinormals.length());
+                    THROW_ON_FAILURE(mBinormals.get(reinterpret_cast<float(*)[3]>(binormals.data())));
+
+                    std::vector<Float3> normals(mTangentSpaceNormals.length());
+                    THROW_ON_FAILURE(mTangentSpaceNormals.get(reinterpret_cast<float(*)[3]>(normals.data())));
+
+                    // The normal of each tangent, from the face-vertices that use it
+                    std::vector<int> tangentNormalIds(numTangents, -1);
+
+                    const auto &faceVertexTangentIds = meshIndices.indicesAt(Semantic::TANGENT, semantic.setIndex);
+                    const auto &faceVertexNormalIds = meshIndices.indicesAt(Semantic::NORMAL, 0);
+
+                    for (size_t i = 0; i < faceVertexTangentIds.size(); ++i) {
+                        const auto tangentId = faceVertexTangentIds[i];
+                        if (tangentId >= 0 && tangentId < numTangents) {
+                            tangentNormalIds[tangentId] = faceVertexNormalIds[i];
+                        }
+                    }
+
+                    for (int i = 0; i < numTangents; ++i) {
+                        const auto normalId = tangentNormalIds[i];
+
+                        if (normalId < 0 || i >= static_cast<int>(binormals.size())) {
+                            // Not used by any face-vertex, so rare that asking Maya is fine
+                            handedness[i] = 2 * mesh.isRightHandedTangent(i, &semantic.setName, &status) - 1.0f;
+                            THROW_ON_FAILURE(status);
+                        } else {
+                            // The tangent space is right handed when (N x T) . B is positive
+                            const auto &n = normals[normalId];
+                            const auto &t = tangents[i];
+                            const auto &b = binormals[i];
+                            const auto d = (n[1] * t[2] - n[2] * t[1]) * b[0] + (n[2] * t[0] - n[0] * t[2]) * b[1] +
+                                           (n[0] * t[1] - n[1] * t[0]) * b[2];
+                            handedness[i] = d >= 0 ? 1.0f : -1.0f;
+                        }
+                    }
+                }
+
+                // Only collect the ids of tangents that are not unit length
+                std::vector<int> invalidTangentIds;
+
+                for (int i = 0; i < numTangents; ++i) {
+                    const auto &t = tangents[i];
+                    const auto l = t[0] * t[0] + t[1] * t[1] + t[2] * t[2];
+                    if (std::abs(l - 1) > 1e-6) {
+                        invalidTangentIds.push_back(i);
+                    }
+                }
+
+                const auto tangentDimension = dimension(Semantic::TANGENT, shapeIndex);
+
+                auto &tangentSet = m_tangentSets[semantic.setIndex];
+                tangentSet.resize(numTangents * tangentDimension);
+
+                for (int i = 0; i < numTangents; ++i) {
+                    const auto &t = tangents[i];
+                    auto *p = &tangentSet[i * tangentDimension];
+                    p[0] = roundToFloat(t[0], args.dirPrecision);
+                    p[1] = roundToFloat(t[1], args.dirPrecision);
+                    p[2] = roundToFloat(t[2], args.dirPrecision);
+
+                    if (!handedness.empty()) {
+                        p[3] = handedness[i];
                     }
                 }
 
@@ -361,7 +421,7 @@ MeshVertices::MeshVertices(const MeshIndices &meshIndices, const MeshSkeleton *m
                     ss << "select -r";
 
                     while (!itFaceVertex.isDone() && selectedIndexCount < 10) {
-                        if (invalidTangentIds.end() != invalidTangentIds.find(itFaceVertex.tangentId())) {
+                        if (std::binary_search(invalidTangentIds.begin(), invalidTangentIds.end(), itFaceVertex.tangentId())) {
                             ss << ' ' << mesh.name() << ".vtxFace[" << itFaceVertex.vertId() << "]["
                                << itFaceVertex.faceId() << "]";
                             ++selectedIndexCount;
@@ -451,6 +511,113 @@ MeshVertices::MeshVertices(const MeshIndices &meshIndices, const MeshSkeleton *m
 
 MeshVertices::~MeshVertices() = default;
 
+std::vector<std::vector<int>> MeshVertices::mikkTSpaceChunks(const size_t chunkTriangleCount) const {
+    const auto triangleCount = static_cast<size_t>(m_meshIndices.primitiveCount());
+
+    if (m_mikkTSpaceSetIndices.empty() || triangleCount < 2 * chunkTriangleCount) {
+        return {{}};
+    }
+
+    // MikkTSpace only shares tangents between triangles with vertices at the same position,
+    // so triangles that are not connected through a position can be processed independently.
+    std::vector<int> parents(triangleCount);
+    std::iota(parents.begin(), parents.end(), 0);
+
+    const auto findRoot = [&parents](int triangleIndex) {
+        while (parents[triangleIndex] != triangleIndex) {
+            triangleIndex = parents[triangleIndex] = parents[parents[triangleIndex]];
+        }
+        return triangleIndex;
+    };
+
+    const auto positionIndices = gsl::make_span(m_meshIndices.indicesAt(Semantic::POSITION, 0));
+
+    // Positions are compared by value, MikkTSpace also welds identical vertices with different indices.
+    std::unordered_map<Position, int, PositionHasher> triangleAtPosition;
+    triangleAtPosition.reserve(m_positions.size());
+
+    for (size_t triangleIndex = 0; triangleIndex < triangleCount; ++triangleIndex) {
+        for (size_t corner = 0; corner < 3; ++corner) {
+            const auto &position = m_positions.at(positionIndices[triangleIndex * 3 + corner]);
+            const auto it = triangleAtPosition.emplace(position, static_cast<int>(triangleIndex)).first;
+            const auto root1 = findRoot(it->second);
+            const auto root2 = findRoot(static_cast<int>(triangleIndex));
+            parents[std::max(root1, root2)] = std::min(root1, root2);
+        }
+    }
+
+    // Collect the connected triangles, and pack these into chunks.
+    std::unordered_map<int, std::vector<int>> trianglesPerRoot;
+    std::vector<int> roots;
+
+    for (size_t triangleIndex = 0; triangleIndex < triangleCount; ++triangleIndex) {
+        const auto root = findRoot(static_cast<int>(triangleIndex));
+        auto &triangles = trianglesPerRoot[root];
+        if (triangles.empty()) {
+            roots.push_back(root);
+        }
+        triangles.push_back(static_cast<int>(triangleIndex));
+    }
+
+    if (roots.size() == 1) {
+        return {{}};
+    }
+
+    std::vector<std::vector<int>> chunks(1);
+
+    for (auto root : roots) {
+        if (chunks.back().size() >= chunkTriangleCount) {
+            chunks.emplace_back();
+        }
+
+        auto &chunk = chunks.back();
+        auto &triangles = trianglesPerRoot.at(root);
+        chunk.insert(chunk.end(), triangles.begin(), triangles.end());
+    }
+
+    // Keep the original triangle order within a chunk
+    for (auto &chunk : chunks) {
+        std::sort(chunk.begin(), chunk.end());
+    }
+
+    return chunks;
+}
+
+void MeshVertices::generateMikkTSpaceTangents(const SetIndex setIndex, const gsl::span<const int> &triangles,
+                                              const double angularThreshold,
+                                              std::unordered_set<int> &invalidTriangleIndices) {
+    MikkTSpaceContext context(m_meshIndices, m_table, setIndex, shapeIndex, triangles);
+    context.computeTangents(angularThreshold);
+
+    if (invalidTriangleIndices.empty()) {
+        invalidTriangleIndices = std::move(context.invalidTriangleIndices);
+    } else {
+        invalidTriangleIndices.insert(context.invalidTriangleIndices.begin(), context.invalidTriangleIndices.end());
+    }
+}
+
+void MeshVertices::reportInvalidMikkTSpaceTriangles(const std::unordered_set<int> &invalidTriangleIndices) const {
+    if (!invalidTriangleIndices.empty()) {
+        // Don't flood the console output if too many faces are invalid.
+        int maxIndices = 10;
+
+        std::stringstream ss;
+        ss << "select -r";
+        for (auto triangleIndex : invalidTriangleIndices) {
+            ss << ' ' << m_meshName << ".f[" << m_meshIndices.triangleToFaceIndex(triangleIndex) << "]";
+            if (--maxIndices < 0)
+                break;
+        }
+        ss << ";";
+
+        MayaException::printError(formatted("Tangent generator found degenerate faces!\nThis can cause "
+                                            "rendering artifacts.\nPlease check and fix your mesh and "
+                                            "UV mapping.\nUse the following command select the first "
+                                            "invalid faces:\n%s\n\n",
+                                            ss.str().c_str()));
+    }
+}
+
 void MeshVertices::dump(IndentableStream &out, const std::string &name) const {
     dump_vertex_table(out, name, m_table, shapeIndex);
 }
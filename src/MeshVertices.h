@@ -98,9 +98,36 @@ class MeshVertices {
         return m_table.at(semanticIndex).at(setIndex);
     }
 
+    /** The tangent sets that still need to be generated with MikkTSpace */
+    const std::vector<SetIndex> &mikkTSpaceSetIndices() const {
+        return m_mikkTSpaceSetIndices;
+    }
+
+    /** Splits the triangles into chunks that don't share any vertex position,
+     * so MikkTSpace can process each chunk independently. Returns a single
+     * empty chunk, meaning all triangles, for smaller meshes */
+    std::vector<std::vector<int>>
+    mikkTSpaceChunks(size_t chunkTriangleCount) const;
+
+    /** Generates the MikkTSpace tangents of the triangles (all when empty).
+     * Doesn't use Maya, so different sets and chunks can be generated
+     * concurrently */
+    void generateMikkTSpaceTangents(SetIndex setIndex,
+                                    const gsl::span<const int> &triangles,
+                                    double angularThreshold,
+                                    std::unordered_set<int> &invalidTriangleIndices);
+
+    void reportInvalidMikkTSpaceTriangles(
+        const std::unordered_set<int> &invalidTriangleIndices) const;
+
   private:
     friend class MeshShape;
 
+    const MeshIndices &m_meshIndices;
+    const MString m_meshName;
+
+    std::vector<SetIndex> m_mikkTSpaceSetIndices;
+
     PositionVector m_positions;
     NormalVector m_normals;
 
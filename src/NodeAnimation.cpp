@@ -1,9 +1,12 @@
 #include "externals.h"
 
+#include "DagHelper.h"
 #include "ExportableMesh.h"
 #include "ExportableNode.h"
 #include "NodeAnimation.h"
 #include "OutputStreamsPatch.h"
+#include "MayaException.h"
+#include "MayaUtils.h"
 #include "Transform.h"
 
 NodeAnimation::NodeAnimation(const ExportableNode &node, const ExportableFrames &frames, const double scaleFactor, const Arguments &arguments)
@@ -17,33 +20,44 @@ NodeAnimation::NodeAnimation(const ExportableNode &node, const ExportableFrames
 
     switch (node.transformKind) {
     case TransformKind::Simple:
-        m_positions = std::make_unique<PropAnimation>(frames, pNode, GLTF::Animation::Path::TRANSLATION, 3, detectStepSampleCount, false);
-        m_rotations = std::make_unique<PropAnimation>(frames, pNode, GLTF::Animation::Path::ROTATION, 4, detectStepSampleCount, false);
-        m_scales = std::make_unique<PropAnimation>(frames, pNode, GLTF::Animation::Path::SCALE, 3, detectStepSampleCount, false);
+        m_positions = std::make_unique<PropAnimation>(frames, pNode, GLTF::Animation::Path::TRANSLATION, 3, detectStepSampleCount, false,
+                                                      m_arguments.constantTranslationThreshold);
+        m_rotations = std::make_unique<PropAnimation>(frames, pNode, GLTF::Animation::Path::ROTATION, 4, detectStepSampleCount, false,
+                                                      m_arguments.constantRotationThreshold);
+        m_scales = std::make_unique<PropAnimation>(frames, pNode, GLTF::Animation::Path::SCALE, 3, detectStepSampleCount, false,
+                                                   m_arguments.constantScalingThreshold);
         break;
     case TransformKind::ComplexJoint:
-        m_positions = std::make_unique<PropAnimation>(frames, sNode, GLTF::Animation::Path::TRANSLATION, 3, detectStepSampleCount, false);
-        m_rotations = std::make_unique<PropAnimation>(frames, pNode, GLTF::Animation::Path::ROTATION, 4, detectStepSampleCount, false);
-        m_scales = std::make_unique<PropAnimation>(frames, pNode, GLTF::Animation::Path::SCALE, 3, detectStepSampleCount, false);
+        m_positions = std::make_unique<PropAnimation>(frames, sNode, GLTF::Animation::Path::TRANSLATION, 3, detectStepSampleCount, false,
+                                                      m_arguments.constantTranslationThreshold);
+        m_rotations = std::make_unique<PropAnimation>(frames, pNode, GLTF::Animation::Path::ROTATION, 4, detectStepSampleCount, false,
+                                                      m_arguments.constantRotationThreshold);
+        m_scales = std::make_unique<PropAnimation>(frames, pNode, GLTF::Animation::Path::SCALE, 3, detectStepSampleCount, false,
+                                                   m_arguments.constantScalingThreshold);
 
-        m_correctors = std::make_unique<PropAnimation>(frames, sNode, GLTF::Animation::Path::SCALE, 3, detectStepSampleCount, false);
+        m_correctors = std::make_unique<PropAnimation>(frames, sNode, GLTF::Animation::Path::SCALE, 3, detectStepSampleCount, false,
+                                                       m_arguments.constantScalingThreshold);
 
         if (m_arguments.forceAnimationChannels) {
-            m_dummyProps1 = std::make_unique<PropAnimation>(frames, pNode, GLTF::Animation::Path::TRANSLATION, 3, detectStepSampleCount, false);
-            m_dummyProps2 = std::make_unique<PropAnimation>(frames, sNode, GLTF::Animation::Path::ROTATION, 4, detectStepSampleCount, false);
+            m_dummyProps1 = std::make_unique<PropAnimation>(frames, pNode, GLTF::Animation::Path::TRANSLATION, 3, detectStepSampleCount, false, 0);
+            m_dummyProps2 = std::make_unique<PropAnimation>(frames, sNode, GLTF::Animation::Path::ROTATION, 4, detectStepSampleCount, false, 0);
         }
         break;
 
     case TransformKind::ComplexTransform:
-        m_positions = std::make_unique<PropAnimation>(frames, sNode, GLTF::Animation::Path::TRANSLATION, 3, detectStepSampleCount, false);
-        m_rotations = std::make_unique<PropAnimation>(frames, sNode, GLTF::Animation::Path::ROTATION, 4, detectStepSampleCount, false);
-        m_scales = std::make_unique<PropAnimation>(frames, sNode, GLTF::Animation::Path::SCALE, 3, detectStepSampleCount, false);
+        m_positions = std::make_unique<PropAnimation>(frames, sNode, GLTF::Animation::Path::TRANSLATION, 3, detectStepSampleCount, false,
+                                                      m_arguments.constantTranslationThreshold);
+        m_rotations = std::make_unique<PropAnimation>(frames, sNode, GLTF::Animation::Path::ROTATION, 4, detectStepSampleCount, false,
+                                                      m_arguments.constantRotationThreshold);
+        m_scales = std::make_unique<PropAnimation>(frames, sNode, GLTF::Animation::Path::SCALE, 3, detectStepSampleCount, false,
+                                                   m_arguments.constantScalingThreshold);
 
-        m_correctors = std::make_unique<PropAnimation>(frames, pNode, GLTF::Animation::Path::TRANSLATION, 3, detectStepSampleCount, false);
+        m_correctors = std::make_unique<PropAnimation>(frames, pNode, GLTF::Animation::Path::TRANSLATION, 3, detectStepSampleCount, false,
+                                                       m_arguments.constantScalingThreshold);
 
         if (m_arguments.forceAnimationChannels) {
-            m_dummyProps1 = std::make_unique<PropAnimation>(frames, pNode, GLTF::Animation::Path::SCALE, 3, detectStepSampleCount, false);
-            m_dummyProps2 = std::make_unique<PropAnimation>(frames, pNode, GLTF::Animation::Path::ROTATION, 4, detectStepSampleCount, false);
+            m_dummyProps1 = std::make_unique<PropAnimation>(frames, pNode, GLTF::Animation::Path::SCALE, 3, detectStepSampleCount, false, 0);
+            m_dummyProps2 = std::make_unique<PropAnimation>(frames, pNode, GLTF::Animation::Path::ROTATION, 4, detectStepSampleCount, false, 0);
         }
         break;
 
@@ -53,11 +67,157 @@ NodeAnimation::NodeAnimation(const ExportableNode &node, const ExportableFrames
     }
 
     if (m_blendShapeCount > 0) {
-        m_weights = std::make_unique<PropAnimation>(frames, pNode, GLTF::Animation::Path::WEIGHTS, m_blendShapeCount, detectStepSampleCount, true);
+        m_weights = std::make_unique<PropAnimation>(frames, pNode, GLTF::Animation::Path::WEIGHTS, m_blendShapeCount, detectStepSampleCount, true,
+                                                    m_arguments.constantWeightsThreshold);
+    }
+
+    if (m_arguments.useAnimationCurves && canUseAnimationCurves()) {
+        loadAnimationCurves(frames);
+    }
+}
+
+bool NodeAnimation::canUseAnimationCurves() const {
+    MStatus status;
+
+    if (node.transformKind != TransformKind::Simple)
+        return false;
+
+    // The local transform must be relative to the DAG parent, not to a logical parent.
+    MDagPath dagParentPath = node.dagPath;
+    THROW_ON_FAILURE(dagParentPath.pop());
+
+    const auto parentPath = node.parentDagPath();
+    if (parentPath.length() != dagParentPath.length() || (parentPath.length() > 0 && !(parentPath == dagParentPath)))
+        return false;
+
+    MFnTransform fnTransform(node.dagPath, &status);
+    if (!status)
+        return false;
+
+    // With segment scale compensation, the parent scale affects the child.
+    bool hasSegmentScaleCompensation = false;
+    DagHelper::getPlugValue(node.obj, "segmentScaleCompensate", hasSegmentScaleCompensation);
+    if (hasSegmentScaleCompensation && node.parentNode && node.parentNode->obj.hasFn(MFn::kJoint))
+        return false;
+
+    // Shear, pivots and the offset parent matrix must not affect the local transform.
+    double shear[3];
+    THROW_ON_FAILURE(fnTransform.getShear(shear));
+    if (shear[0] != 0 || shear[1] != 0 || shear[2] != 0)
+        return false;
+
+    if (fnTransform.rotatePivot(MSpace::kTransform) != MPoint::origin || fnTransform.scalePivot(MSpace::kTransform) != MPoint::origin ||
+        fnTransform.rotatePivotTranslation(MSpace::kTransform) != MVector::zero ||
+        fnTransform.scalePivotTranslation(MSpace::kTransform) != MVector::zero)
+        return false;
+
+    MPlug offsetParentMatrixPlug = fnTransform.findPlug("offsetParentMatrix", true, &status);
+    if (status && !utils::getMatrix(offsetParentMatrixPlug).isEquivalent(MMatrix::identity))
+        return false;
+
+    for (auto attributeName : {"shear", "rotatePivot", "scalePivot", "rotatePivotTranslate", "scalePivotTranslate", "offsetParentMatrix",
+                               "rotateOrder", "rotateAxis", "jointOrient"}) {
+        MPlug plug = fnTransform.findPlug(attributeName, true, &status);
+        if (status && utils::isTimeDependent(plug))
+            return false;
+    }
+
+    return true;
+}
+
+void NodeAnimation::loadAnimationCurves(const ExportableFrames &frames) {
+    MStatus status;
+
+    MFnTransform fnTransform(node.dagPath, &status);
+    THROW_ON_FAILURE(status);
+
+    const auto tryLoadCurves = [&](const char *attributeName, std::array<AnimCurveChannel, 3> &curves) {
+        MPlug plug = fnTransform.findPlug(attributeName, true, &status);
+        THROW_ON_FAILURE(status);
+
+        for (unsigned axis = 0; axis < 3; ++axis) {
+            if (!curves[axis].tryLoad(plug.child(axis)))
+                return false;
+        }
+        return true;
+    };
+
+    CubicSplineKeys keys;
+
+    std::array<AnimCurveChannel, 3> translationCurves;
+    if (tryLoadCurves("translate", translationCurves) &&
+        AnimCurveChannel::tryGetCubicSplineKeys(translationCurves, frames.startTime, frames.endTime(), m_scaleFactor, m_arguments.posPrecision, keys)) {
+        m_positions->setCubicSplineKeys(std::move(keys.times), std::move(keys.values));
+    }
+
+    // The scale decomposition of the local matrix only matches the scale attribute when it is positive.
+    std::array<AnimCurveChannel, 3> scaleCurves;
+    if (tryLoadCurves("scale", scaleCurves) &&
+        AnimCurveChannel::tryGetCubicSplineKeys(scaleCurves, frames.startTime, frames.endTime(), 1, m_arguments.sclPrecision, keys)) {
+        auto isPositive = true;
+        for (size_t offset = 3; offset < keys.values.size() && isPositive; offset += 9) {
+            isPositive = keys.values[offset] > 0 && keys.values[offset + 1] > 0 && keys.values[offset + 2] > 0;
+        }
+
+        if (isPositive) {
+            m_scales->setCubicSplineKeys(std::move(keys.times), std::move(keys.values));
+        }
+    }
+
+    // Only skip the timeline when nothing else needs to be sampled.
+    if (m_positions->hasCubicSplineKeys() && m_scales->hasCubicSplineKeys() && m_blendShapeCount == 0 &&
+        tryLoadCurves("rotate", m_rotationCurves)) {
+        int rotateOrder = 0;
+        THROW_ON_FAILURE(DagHelper::getPlugValue(node.obj, "rotateOrder", rotateOrder));
+        m_rotateOrder = static_cast<MEulerRotation::RotationOrder>(rotateOrder);
+
+        m_rotateAxis = fnTransform.rotateOrientation(MSpace::kTransform);
+
+        MVector jointOrient;
+        if (DagHelper::getPlugValue(node.obj, "jointOrient", jointOrient)) {
+            m_jointOrient = MEulerRotation(jointOrient).asQuaternion();
+        }
+
+        m_usesRotationCurves = true;
     }
 }
 
+void NodeAnimation::sampleAnimationCurvesAt(const MTime &absoluteTime, const int superSampleIndex) {
+    const MEulerRotation rotation(m_rotationCurves[0].evaluate(absoluteTime), m_rotationCurves[1].evaluate(absoluteTime),
+                                  m_rotationCurves[2].evaluate(absoluteTime), m_rotateOrder);
+
+    // Maya's joint matrix is [S] * [RO] * [R] * [JO] * [IS] * [T], a transform has no joint orient.
+    const auto q = m_rotateAxis * rotation.asQuaternion() * m_jointOrient;
+
+    const auto dirPrecision = m_arguments.dirPrecision;
+    double components[4] = {roundTo(q.x, dirPrecision), roundTo(q.y, dirPrecision), roundTo(q.z, dirPrecision), roundTo(q.w, dirPrecision)};
+
+    MQuaternion mq(components);
+    mq.normalizeIt();
+
+    float values[4] = {static_cast<float>(mq.x), static_cast<float>(mq.y), static_cast<float>(mq.z), static_cast<float>(mq.w)};
+
+    // Start in the same hemisphere as the initial rotation, that was decomposed from the matrix.
+    if (m_rotations->firstValues().empty()) {
+        auto &initialRotation = node.initialTransformState.primaryTRS().rotation;
+        const auto dot = values[0] * initialRotation[0] + values[1] * initialRotation[1] + values[2] * initialRotation[2] +
+                         values[3] * initialRotation[3];
+        if (dot < 0) {
+            for (auto &value : values) {
+                value = -value;
+            }
+        }
+    }
+
+    m_rotations->appendQuaternion(gsl::make_span(values), superSampleIndex);
+}
+
 void NodeAnimation::sampleAt(const MTime &absoluteTime, const int frameIndex, const int superSampleIndex, NodeTransformCache &transformCache) {
+    if (m_usesRotationCurves) {
+        sampleAnimationCurvesAt(absoluteTime, superSampleIndex);
+        return;
+    }
+
     auto &transformState = transformCache.getTransform(&node, m_scaleFactor, m_arguments.posPrecision, m_arguments.sclPrecision, m_arguments.dirPrecision);
     auto &pTRS = transformState.primaryTRS();
     auto &sTRS = transformState.secondaryTRS();
@@ -69,9 +229,14 @@ void NodeAnimation::sampleAt(const MTime &absoluteTime, const int frameIndex, co
 
     switch (node.transformKind) {
     case TransformKind::Simple:
-        m_positions->append(gsl::make_span(pTRS.translation), superSampleIndex);
+        // Channels driven by animation curves already have their keys.
+        if (!m_positions->hasCubicSplineKeys()) {
+            m_positions->append(gsl::make_span(pTRS.translation), superSampleIndex);
+        }
         m_rotations->appendQuaternion(gsl::make_span(pTRS.rotation), superSampleIndex);
-        m_scales->append(gsl::make_span(pTRS.scale), superSampleIndex);
+        if (!m_scales->hasCubicSplineKeys()) {
+            m_scales->append(gsl::make_span(pTRS.scale), superSampleIndex);
+        }
         break;
     case TransformKind::ComplexJoint:
         m_positions->append(gsl::make_span(sTRS.translation), superSampleIndex);
@@ -111,6 +276,14 @@ void NodeAnimation::sampleAt(const MTime &absoluteTime, const int frameIndex, co
     }
 }
 
+void NodeAnimation::collectProps(std::vector<PropAnimation *> &props) const {
+    for (auto *prop : {&m_positions, &m_rotations, &m_scales, &m_correctors, &m_dummyProps1, &m_dummyProps2, &m_weights}) {
+        if (*prop && (*prop)->dimension > 0) {
+            props.push_back(prop->get());
+        }
+    }
+}
+
 void NodeAnimation::exportTo(GLTF::Animation &glAnimation) {
 
     if (!m_invalidLocalTransformTimes.empty()) {
@@ -134,33 +307,33 @@ void NodeAnimation::exportTo(GLTF::Animation &glAnimation) {
 
     switch (node.transformKind) {
     case TransformKind::Simple:
-        finish(glAnimation, "T", m_positions, m_arguments.constantTranslationThreshold, pTRS.translation);
-        finish(glAnimation, "R", m_rotations, m_arguments.constantRotationThreshold, pTRS.rotation);
-        finish(glAnimation, "S", m_scales, m_arguments.constantScalingThreshold, pTRS.scale);
+        finish(glAnimation, "T", m_positions, pTRS.translation);
+        finish(glAnimation, "R", m_rotations, pTRS.rotation);
+        finish(glAnimation, "S", m_scales, pTRS.scale);
         break;
     case TransformKind::ComplexJoint:
-        finish(glAnimation, "T", m_positions, m_arguments.constantTranslationThreshold, sTRS.translation);
-        finish(glAnimation, "R", m_rotations, m_arguments.constantRotationThreshold, pTRS.rotation);
-        finish(glAnimation, "S", m_scales, m_arguments.constantScalingThreshold, pTRS.scale);
+        finish(glAnimation, "T", m_positions, sTRS.translation);
+        finish(glAnimation, "R", m_rotations, pTRS.rotation);
+        finish(glAnimation, "S", m_scales, pTRS.scale);
 
-        finish(glAnimation, "C", m_correctors, m_arguments.constantScalingThreshold, sTRS.scale);
+        finish(glAnimation, "C", m_correctors, sTRS.scale);
 
         if (m_arguments.forceAnimationChannels) {
-            finish(glAnimation, "DT", m_dummyProps1, 0, pTRS.translation);
-            finish(glAnimation, "DR", m_dummyProps2, 0, sTRS.rotation);
+            finish(glAnimation, "DT", m_dummyProps1, pTRS.translation);
+            finish(glAnimation, "DR", m_dummyProps2, sTRS.rotation);
         }
         break;
 
     case TransformKind::ComplexTransform:
-        finish(glAnimation, "T", m_positions, m_arguments.constantTranslationThreshold, sTRS.translation);
-        finish(glAnimation, "R", m_rotations, m_arguments.constantRotationThreshold, sTRS.rotation);
-        finish(glAnimation, "S", m_scales, m_arguments.constantScalingThreshold, sTRS.scale);
+        finish(glAnimation, "T", m_positions, sTRS.translation);
+        finish(glAnimation, "R", m_rotations, sTRS.rotation);
+        finish(glAnimation, "S", m_scales, sTRS.scale);
 
-        finish(glAnimation, "C", m_correctors, m_arguments.constantScalingThreshold, pTRS.translation);
+        finish(glAnimation, "C", m_correctors, pTRS.translation);
 
         if (m_arguments.forceAnimationChannels) {
-            finish(glAnimation, "DS", m_dummyProps1, 0, pTRS.scale);
-            finish(glAnimation, "DR", m_dummyProps2, 0, pTRS.rotation);
+            finish(glAnimation, "DS", m_dummyProps1, pTRS.scale);
+            finish(glAnimation, "DR", m_dummyProps2, pTRS.rotation);
         }
         break;
 
@@ -172,58 +345,50 @@ void NodeAnimation::exportTo(GLTF::Animation &glAnimation) {
     if (m_blendShapeCount) {
         const auto initialWeights = mesh->initialWeights();
         assert(initialWeights.size() == m_blendShapeCount);
-        finish(glAnimation, "W", m_weights, m_arguments.constantWeightsThreshold, initialWeights);
+        finish(glAnimation, "W", m_weights, initialWeights);
     }
 }
 
 void NodeAnimation::finish(GLTF::Animation &glAnimation, const char *propName, std::unique_ptr<PropAnimation> &animatedProp,
-    double constantThreshold, const gsl::span<const float> &baseValues) const {
+                           const gsl::span<const float> &baseValues) const {
     const auto dimension = animatedProp->dimension;
 
     if (dimension) {
         assert(dimension == baseValues.size());
 
-        const size_t detectStepSampleCount = m_arguments.getStepDetectSampleCount();
+        const auto constantThreshold = animatedProp->constantThreshold;
 
-        auto &componentValues = animatedProp->componentValuesPerFrameTable.at(0);
+        // The prop tracks whether all samples are the same as its first sample.
+        // If that sample also matches the scene, we drop the animation, unless it is forced
+        const auto isConstant = animatedProp->isConstant();
+        const auto firstValues = animatedProp->firstValues();
 
-        // Check if all samples are constant. In that case, we drop the animation, unless it is forced
-        bool isConstant = true;
-        for (size_t offset = 0; offset < componentValues.size() && isConstant; offset += dimension) {
-            for (size_t axis = 0; axis < dimension && isConstant; ++axis) {
-                isConstant = std::abs(baseValues[axis] - componentValues[offset + axis]) < constantThreshold;
-            }
+        bool isSameAsScene = isConstant;
+        for (size_t axis = 0; axis < dimension && isSameAsScene; ++axis) {
+            isSameAsScene = std::abs(baseValues[axis] - firstValues[axis]) < constantThreshold;
         }
 
-        if (isConstant && !m_arguments.forceAnimationSampling && !m_arguments.forceAnimationChannels) {
+        if (isSameAsScene && !m_arguments.forceAnimationSampling && !m_arguments.forceAnimationChannels) {
             // All animation frames are the same as the scene, to need to animate the prop.
-            animatedProp.release();
+            animatedProp.reset();
         } else {
             const auto useSingleKey = isConstant && !m_arguments.forceAnimationSampling;
-            auto interpolation = "LINEAR";
-
-            if (!useSingleKey && detectStepSampleCount > 1) {
-                // Check if STEP animation can be used for this channel.
-                // TODO: Split into multiple parts!
-                auto canUseStep = true;
-                for (size_t offset = 0; offset < componentValues.size() && canUseStep; offset += dimension) {
-                    const auto* startValues = &componentValues[offset];
-                    for (size_t superSample = 1; superSample < detectStepSampleCount; ++superSample) {
-                        auto &stepComponentValues = animatedProp->componentValuesPerFrameTable.at(superSample);
-                        for (size_t axis = 0; axis < dimension; ++axis) {
-                            canUseStep = std::abs(startValues[axis] - stepComponentValues[offset + axis]) < constantThreshold;
-                        }
-                    }
-                }
-
-                if (canUseStep) {
-                    std::cout << prefix << "Using STEP interpolation for channel " << node.name() << "/" << propName << std::endl;
-                    interpolation = "STEP";
-                }
+
+            // Only rotations and weights are allowed to be normalized integers by the glTF spec
+            const auto path = animatedProp->glTarget.path;
+            const auto quantizationBits = path == GLTF::Animation::Path::ROTATION  ? (m_arguments.quantizeRotations ? 16 : 0)
+                                          : path == GLTF::Animation::Path::WEIGHTS ? m_arguments.quantizeWeights
+                                                                                   : 0;
+
+            // Forced sampling exports all frames, otherwise the keys inside holds are dropped.
+            animatedProp->finish(m_arguments.disableNameAssignment ? "" : node.name() + "/anim/" + glAnimation.name + "/" + propName, useSingleKey,
+                                 !m_arguments.forceAnimationSampling, quantizationBits);
+
+            if (animatedProp->stepCount() > 0) {
+                std::cout << prefix << "Using STEP interpolation for " << animatedProp->stepCount() << " frame intervals of channel " << node.name()
+                          << "/" << propName << std::endl;
             }
 
-            // TODO: Apply a curve simplifier.
-            animatedProp->finish(m_arguments.disableNameAssignment ? "" : node.name() + "/anim/" + glAnimation.name + "/" + propName, useSingleKey, interpolation);
             glAnimation.channels.push_back(&animatedProp->glChannel);
         }
     }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "AnimCurveChannel.h"
 #include "ExportableNode.h"
 #include "PropAnimation.h"
 #include "Arguments.h"
@@ -20,8 +21,15 @@ class NodeAnimation {
     // Samples values at the current time
     void sampleAt(const MTime &absoluteTime, int relativeFrameIndex, int superSampleIndex, NodeTransformCache &transformCache);
 
+    // Must the timeline be evaluated at each frame for this node?
+    // False when all transform channels are driven directly by animation curves.
+    bool requiresTimeline() const { return !m_usesRotationCurves; }
+
     void exportTo(GLTF::Animation &glAnimation);
 
+    // Appends the animated props, e.g. to post-process their samples.
+    void collectProps(std::vector<PropAnimation *> &props) const;
+
     const ExportableNode &node;
     const ExportableMesh *mesh;
 
@@ -46,13 +54,21 @@ class NodeAnimation {
 
     std::unique_ptr<PropAnimation> m_weights;
 
-    void finish(GLTF::Animation &glAnimation, const char *propName, std::unique_ptr<PropAnimation> &animatedProp, double constantThreshold, const gsl::span<const float> &baseValues) const;
+    // When the transform is driven by animation curves, the rotation is evaluated from these.
+    std::array<AnimCurveChannel, 3> m_rotationCurves;
+    MQuaternion m_rotateAxis;
+    MQuaternion m_jointOrient;
+    MEulerRotation::RotationOrder m_rotateOrder = MEulerRotation::kXYZ;
+    bool m_usesRotationCurves = false;
+
+    bool canUseAnimationCurves() const;
+
+    void loadAnimationCurves(const ExportableFrames &frames);
+
+    void sampleAnimationCurvesAt(const MTime &absoluteTime, int superSampleIndex);
 
-    template <int N>
-    void finish(GLTF::Animation &glAnimation, const char *propName, std::unique_ptr<PropAnimation> &animatedProp, 
-        double constantThreshold, int detectStepSampleCount, const float (&baseValues)[N]) {
-        finish(glAnimation, propName, animatedProp, constantThreshold, detectStepSampleCount, gsl::make_span(&baseValues[0], N));
-    }
+    void finish(GLTF::Animation &glAnimation, const char *propName, std::unique_ptr<PropAnimation> &animatedProp,
+                const gsl::span<const float> &baseValues) const;
 
     DISALLOW_COPY_MOVE_ASSIGN(NodeAnimation);
 };
@@ -0,0 +1,401 @@
+#include "externals.h"
+
+#include "PropAnimation.h"
+
+PropAnimation::PropAnimation(const ExportableFrames &frames, const GLTF::Node &node, const GLTF::Animation::Path path, const size_t dimension,
+                             const size_t stepDetectSampleCount, const bool useFloatArray, const double constantThreshold)
+    : dimension(dimension), useFloatArray(useFloatArray), stepDetectSampleCount(stepDetectSampleCount), constantThreshold(constantThreshold),
+      frames(frames) {
+
+    // Nothing is reserved up front: constant channels only keep their first sample.
+    glTarget.node = &const_cast<GLTF::Node &>(node);
+    glTarget.path = path;
+
+    glChannel.sampler = &glSampler;
+    glChannel.target = &glTarget;
+}
+
+void PropAnimation::append(const gsl::span<const float> &components, const size_t superSample) {
+    assert(components.size() == dimension);
+
+    m_lastValues.assign(components.begin(), components.end());
+
+    if (superSample > 0) {
+        // A step-detection super-sample between this frame and the next.
+        // If it differs from the frame value, the interval is not held.
+        if (!m_isHeldInterval.empty() && m_isHeldInterval.back()) {
+            m_isHeldInterval.back() = isSame(m_frameValues.data(), components.data());
+        }
+        return;
+    }
+
+    if (m_firstValues.empty()) {
+        m_firstValues.assign(components.begin(), components.end());
+    } else if (m_isConstant) {
+        m_isConstant = isSame(m_firstValues.data(), components.data());
+
+        if (!m_isConstant) {
+            expandConstantSamples();
+        }
+    }
+
+    if (!m_isConstant) {
+        store(components);
+    }
+
+    if (stepDetectSampleCount > 1) {
+        m_isHeldInterval.push_back(true);
+    }
+
+    m_frameValues.assign(components.begin(), components.end());
+    m_frameCount += 1;
+}
+
+void PropAnimation::appendQuaternion(const gsl::span<const float, 4> &q, const size_t superSample) {
+    if (m_lastValues.empty()) {
+        append(q, superSample);
+    } else {
+        auto x0 = m_lastValues[0];
+        auto y0 = m_lastValues[1];
+        auto z0 = m_lastValues[2];
+        auto w0 = m_lastValues[3];
+
+        auto x1 = q[0];
+        auto y1 = q[1];
+        auto z1 = q[2];
+        auto w1 = q[3];
+
+        // Check if the negative quaternion is a closer.
+        auto dp = (x0 - x1) * (x0 - x1) + (y0 - y1) * (y0 - y1) + (z0 - z1) * (z0 - z1) + (w0 - w1) * (w0 - w1);
+        auto dn = (x0 + x1) * (x0 + x1) + (y0 + y1) * (y0 + y1) + (z0 + z1) * (z0 + z1) + (w0 + w1) * (w0 + w1);
+
+        if (dn < dp) {
+            x1 = -x1;
+            y1 = -y1;
+            z1 = -z1;
+            w1 = -w1;
+        }
+
+        const float values[] = {x1, y1, z1, w1};
+        append(gsl::make_span(values), superSample);
+    }
+}
+
+void PropAnimation::setCubicSplineKeys(std::vector<float> times, std::vector<float> values) {
+    assert(values.size() == times.size() * 3 * dimension);
+    assert(!times.empty());
+
+    m_isCubicSpline = true;
+    m_inputValues = std::move(times);
+    m_outputValues = std::move(values);
+
+    const auto keyStride = 3 * dimension;
+    const auto *firstValues = &m_outputValues[dimension];
+    m_firstValues.assign(firstValues, firstValues + dimension);
+
+    // The channel is constant when all keys have the same value, and flat tangents.
+    m_isConstant = true;
+    for (size_t offset = 0; offset < m_outputValues.size() && m_isConstant; offset += keyStride) {
+        for (size_t axis = 0; axis < dimension && m_isConstant; ++axis) {
+            m_isConstant = std::abs(m_outputValues[offset + axis]) < constantThreshold &&
+                           std::abs(m_outputValues[offset + dimension + axis] - m_firstValues[axis]) < constantThreshold &&
+                           std::abs(m_outputValues[offset + 2 * dimension + axis]) < constantThreshold;
+        }
+    }
+}
+
+void PropAnimation::fitCubicSplineKeys(const double tolerance) {
+    if (m_isConstant || m_isCubicSpline || m_frameCount < 3 || tolerance <= 0)
+        return;
+
+    const auto values = componentValues();
+    const auto times = frames.times();
+    const auto frameCount = m_frameCount;
+    assert(frameCount <= times.size());
+
+    const auto frameValues = [&](const size_t frameIndex) { return &values[frameIndex * dimension]; };
+
+    // A Hermite spline is continuous, so it cannot represent steps.
+    for (size_t frameIndex = 0; frameIndex + 1 < frameCount && frameIndex < m_isHeldInterval.size(); ++frameIndex) {
+        if (m_isHeldInterval[frameIndex] && !isSame(frameValues(frameIndex), frameValues(frameIndex + 1)))
+            return;
+    }
+
+    // The tangent at each frame is the derivative of the parabola through the 3 nearest frames.
+    std::vector<float> slopes(frameCount * dimension);
+
+    for (size_t frameIndex = 0; frameIndex < frameCount; ++frameIndex) {
+        const auto i0 = std::min(frameIndex > 0 ? frameIndex - 1 : 0, frameCount - 3);
+
+        const double t = times[frameIndex];
+        const double t0 = times[i0];
+        const double t1 = times[i0 + 1];
+        const double t2 = times[i0 + 2];
+
+        const auto w0 = (2 * t - t1 - t2) / ((t0 - t1) * (t0 - t2));
+        const auto w1 = (2 * t - t0 - t2) / ((t1 - t0) * (t1 - t2));
+        const auto w2 = (2 * t - t0 - t1) / ((t2 - t0) * (t2 - t1));
+
+        for (size_t axis = 0; axis < dimension; ++axis) {
+            slopes[frameIndex * dimension + axis] =
+                static_cast<float>(w0 * frameValues(i0)[axis] + w1 * frameValues(i0 + 1)[axis] + w2 * frameValues(i0 + 2)[axis]);
+        }
+    }
+
+    // Does the Hermite segment between two key frames reproduce the frames in between?
+    const auto isFit = [&](const size_t keyFrame1, const size_t keyFrame2) {
+        const double start = times[keyFrame1];
+        const double duration = times[keyFrame2] - start;
+
+        for (auto frameIndex = keyFrame1 + 1; frameIndex < keyFrame2; ++frameIndex) {
+            const auto s = (times[frameIndex] - start) / duration;
+            const auto s2 = s * s;
+            const auto s3 = s2 * s;
+
+            const auto h00 = 2 * s3 - 3 * s2 + 1;
+            const auto h10 = (s3 - 2 * s2 + s) * duration;
+            const auto h01 = -2 * s3 + 3 * s2;
+            const auto h11 = (s3 - s2) * duration;
+
+            for (size_t axis = 0; axis < dimension; ++axis) {
+                const auto value = h00 * frameValues(keyFrame1)[axis] + h10 * slopes[keyFrame1 * dimension + axis] +
+                                   h01 * frameValues(keyFrame2)[axis] + h11 * slopes[keyFrame2 * dimension + axis];
+
+                if (!(std::abs(value - frameValues(frameIndex)[axis]) <= tolerance))
+                    return false;
+            }
+        }
+
+        return true;
+    };
+
+    // Greedily make each segment as long as possible, by doubling its length until it doesn't fit,
+    // and then bisecting. The fit is verified for every segment, so this only affects the key count.
+    std::vector<size_t> keyFrameIndices{0};
+
+    for (size_t keyFrame = 0; keyFrame + 1 < frameCount;) {
+        auto fitLength = size_t{1};
+        auto failLength = frameCount - keyFrame;
+
+        for (auto length = size_t{2}; length < failLength; length *= 2) {
+            if (!isFit(keyFrame, keyFrame + length)) {
+                failLength = length;
+                break;
+            }
+            fitLength = length;
+        }
+
+        while (failLength - fitLength > 1) {
+            const auto length = (fitLength + failLength) / 2;
+            (isFit(keyFrame, keyFrame + length) ? fitLength : failLength) = length;
+        }
+
+        keyFrame += fitLength;
+        keyFrameIndices.push_back(keyFrame);
+    }
+
+    // Each key has a time, in-tangents, values and out-tangents.
+    const auto keyCount = keyFrameIndices.size();
+    if (keyCount * (3 * dimension + 1) >= frameCount * dimension)
+        return;
+
+    std::vector<float> keyTimes;
+    std::vector<float> keyValues;
+    keyTimes.reserve(keyCount);
+    keyValues.reserve(keyCount * 3 * dimension);
+
+    for (auto frameIndex : keyFrameIndices) {
+        keyTimes.push_back(times[frameIndex]);
+
+        const auto *keySlopes = &slopes[frameIndex * dimension];
+        const auto *keyValues0 = frameValues(frameIndex);
+
+        keyValues.insert(keyValues.end(), keySlopes, keySlopes + dimension);
+        keyValues.insert(keyValues.end(), keyValues0, keyValues0 + dimension);
+        keyValues.insert(keyValues.end(), keySlopes, keySlopes + dimension);
+    }
+
+    setCubicSplineKeys(std::move(keyTimes), std::move(keyValues));
+}
+
+std::vector<float> PropAnimation::componentValues() const {
+    std::vector<float> values;
+    values.reserve(m_frameCount * dimension);
+
+    if (m_isConstant) {
+        for (size_t index = 0; index < m_frameCount; ++index) {
+            values.insert(values.end(), m_firstValues.begin(), m_firstValues.end());
+        }
+    } else {
+        for (auto &chunk : m_chunks) {
+            values.insert(values.end(), chunk.begin(), chunk.end());
+        }
+    }
+
+    return values;
+}
+
+void PropAnimation::finish(const std::string &name, const bool useSingleKey, const bool compactKeys, const int quantizationBits) {
+    if (!m_outputs) {
+        glSampler.interpolation = "LINEAR";
+
+        if (useSingleKey) {
+            m_outputValues = m_firstValues;
+            glSampler.input = frames.glInput0();
+        } else if (m_isCubicSpline) {
+            glSampler.interpolation = "CUBICSPLINE";
+            m_inputs = contiguousChannelAccessor(name + "/times", span(m_inputValues), 1);
+            glSampler.input = m_inputs.get();
+        } else {
+            auto values = componentValues();
+
+            if (computeKeys(values, compactKeys)) {
+                m_inputs = contiguousChannelAccessor(name + "/times", span(m_inputValues), 1);
+                glSampler.input = m_inputs.get();
+            } else {
+                m_outputValues = std::move(values);
+                glSampler.input = frames.glInputs();
+            }
+        }
+
+        // The samples are no longer needed
+        m_chunks.clear();
+        m_isHeldInterval.clear();
+
+        const auto isCubicSpline = m_isCubicSpline && !useSingleKey;
+
+        m_keyCount = m_outputValues.size() / dimension / (isCubicSpline ? 3 : 1);
+
+        // The tangents of cubic splines are not bounded, so these cannot be normalized.
+        if (quantizationBits > 0 && !isCubicSpline) {
+            m_outputs = normalizedChannelAccessor(name, span(m_outputValues), useFloatArray ? 1 : dimension, quantizationBits,
+                                                  m_quantizedOutputValues);
+        }
+
+        if (!m_outputs) {
+            m_outputs = contiguousChannelAccessor(name, span(m_outputValues), useFloatArray ? 1 : dimension);
+        }
+
+        glSampler.output = m_outputs.get();
+
+        // A channel cannot have a name according to the spec.
+        // glChannel.name = name;
+    }
+}
+
+void PropAnimation::store(const gsl::span<const float> &components) {
+    const auto chunkSize = std::min<size_t>(chunkFrameCount, std::max(frames.count, 1)) * dimension;
+
+    if (m_chunks.empty() || m_chunks.back().size() + dimension > chunkSize) {
+        m_chunks.emplace_back();
+        m_chunks.back().reserve(chunkSize);
+    }
+
+    m_chunks.back().insert(m_chunks.back().end(), components.begin(), components.end());
+}
+
+void PropAnimation::expandConstantSamples() {
+    const auto firstValues = span(m_firstValues);
+
+    for (size_t index = 0; index < m_frameCount; ++index) {
+        store(firstValues);
+    }
+}
+
+bool PropAnimation::isSame(const float *values1, const float *values2) const {
+    for (size_t axis = 0; axis < dimension; ++axis) {
+        if (!(std::abs(values1[axis] - values2[axis]) < constantThreshold))
+            return false;
+    }
+    return true;
+}
+
+bool PropAnimation::computeKeys(const std::vector<float> &values, const bool compactKeys) {
+    const auto times = frames.times();
+    const auto frameCount = values.size() / dimension;
+    assert(frameCount <= times.size());
+
+    const auto frameValues = [&](const size_t frameIndex) { return &values[frameIndex * dimension]; };
+
+    // Classify each frame interval as a hold, a step or a linear change.
+    std::vector<bool> isStepInterval(frameCount, false);
+    size_t linearCount = 0;
+
+    m_stepCount = 0;
+
+    for (size_t frameIndex = 0; frameIndex + 1 < frameCount; ++frameIndex) {
+        if (isSame(frameValues(frameIndex), frameValues(frameIndex + 1)))
+            continue;
+
+        if (frameIndex < m_isHeldInterval.size() && m_isHeldInterval[frameIndex]) {
+            isStepInterval[frameIndex] = true;
+            ++m_stepCount;
+        } else {
+            ++linearCount;
+        }
+    }
+
+    const auto useStep = m_stepCount > 0 && linearCount == 0;
+
+    if (useStep) {
+        glSampler.interpolation = "STEP";
+    } else if (!compactKeys) {
+        // Without extra keys, a LINEAR channel cannot represent the steps.
+        m_stepCount = 0;
+    }
+
+    if (!compactKeys)
+        return false;
+
+    // Each frame is a key. In a LINEAR channel, a step also needs a key that holds the
+    // previous value until just before the next frame (glTF requires increasing key times)
+    struct Key {
+        float time;
+        size_t frameIndex;
+    };
+
+    std::vector<Key> keys;
+    keys.reserve(frameCount + m_stepCount);
+
+    for (size_t frameIndex = 0; frameIndex < frameCount; ++frameIndex) {
+        if (!useStep && frameIndex > 0 && isStepInterval[frameIndex - 1]) {
+            keys.push_back({std::nextafter(times[frameIndex], times[frameIndex - 1]), frameIndex - 1});
+        }
+        keys.push_back({times[frameIndex], frameIndex});
+    }
+
+    // Drop the keys inside holds, always keeping the first and last key, so the clip duration is preserved.
+    std::vector<size_t> keptKeyIndices;
+    keptKeyIndices.reserve(keys.size());
+
+    for (size_t keyIndex = 0; keyIndex < keys.size(); ++keyIndex) {
+        if (keyIndex > 0 && keyIndex + 1 < keys.size()) {
+            const auto *anchorValues = frameValues(keys[keptKeyIndices.back()].frameIndex);
+            const auto isHeld = isSame(anchorValues, frameValues(keys[keyIndex].frameIndex));
+
+            if (isHeld && (useStep || isSame(anchorValues, frameValues(keys[keyIndex + 1].frameIndex))))
+                continue;
+        }
+
+        keptKeyIndices.push_back(keyIndex);
+    }
+
+    // Only use separate key times when that is smaller than using all frames.
+    const auto hasExtraKeys = keys.size() > frameCount;
+    if (!hasExtraKeys && keptKeyIndices.size() * (dimension + 1) >= frameCount * dimension)
+        return false;
+
+    m_inputValues.clear();
+    m_outputValues.clear();
+    m_inputValues.reserve(keptKeyIndices.size());
+    m_outputValues.reserve(keptKeyIndices.size() * dimension);
+
+    for (auto keyIndex : keptKeyIndices) {
+        auto &key = keys[keyIndex];
+        const auto *keyValues = frameValues(key.frameIndex);
+        m_inputValues.push_back(key.time);
+        m_outputValues.insert(m_outputValues.end(), keyValues, keyValues + dimension);
+    }
+
+    return true;
+}
@@ -8,103 +8,100 @@ class ExportableNode;
 
 class PropAnimation {
   public:
-    PropAnimation(const ExportableFrames &frames, const GLTF::Node &node, const GLTF::Animation::Path path, const size_t dimension,
-                  size_t stepDetectSampleCount, const bool useFloatArray)
-        : dimension(dimension), useFloatArray(useFloatArray), stepDetectSampleCount(stepDetectSampleCount), frames(frames) {
-
-        componentValuesPerFrameTable.resize(stepDetectSampleCount);
-        for (auto superSample = 0; superSample < stepDetectSampleCount; ++superSample) {
-            componentValuesPerFrameTable[superSample].reserve(frames.count * dimension);
-        }
-
-        glTarget.node = &const_cast<GLTF::Node &>(node);
-        glTarget.path = path;
-
-        glChannel.sampler = &glSampler;
-        glChannel.target = &glTarget;
-    }
+    PropAnimation(const ExportableFrames &frames, const GLTF::Node &node, GLTF::Animation::Path path, size_t dimension,
+                  size_t stepDetectSampleCount, bool useFloatArray, double constantThreshold);
 
     ~PropAnimation() = default;
 
     const size_t dimension;
     const bool useFloatArray;
     const size_t stepDetectSampleCount;
+    const double constantThreshold;
     const ExportableFrames &frames;
 
-    // For each step-detection super-sampling frame, a vector of component values
-    std::vector<std::vector<float>> componentValuesPerFrameTable;
-
     GLTF::Animation::Channel glChannel;
     GLTF::Animation::Sampler glSampler;
     GLTF::Animation::Channel::Target glTarget;
 
-    template <std::ptrdiff_t Extent> void append(const gsl::span<const float, Extent> &components, size_t superSample) {
-        std::copy(components.begin(), components.end(), std::back_inserter(componentValuesPerFrameTable.at(superSample)));
-    }
-
-    void appendQuaternion(const gsl::span<const float, 4> &q, int superSample) {
-        auto &componentValuesPerFrame = componentValuesPerFrameTable.at(superSample);
-
-        const auto index = componentValuesPerFrame.size();
-        if (index == 0) {
-            append(q, superSample);
-        } else {
-            auto x0 = componentValuesPerFrame[index - 4];
-            auto y0 = componentValuesPerFrame[index - 3];
-            auto z0 = componentValuesPerFrame[index - 2];
-            auto w0 = componentValuesPerFrame[index - 1];
-
-            auto x1 = q[0];
-            auto y1 = q[1];
-            auto z1 = q[2];
-            auto w1 = q[3];
-
-            // Check if the negative quaternion is a closer.
-            auto dp = (x0 - x1) * (x0 - x1) + (y0 - y1) * (y0 - y1) + (z0 - z1) * (z0 - z1) + (w0 - w1) * (w0 - w1);
-            auto dn = (x0 + x1) * (x0 + x1) + (y0 + y1) * (y0 + y1) + (z0 + z1) * (z0 + z1) + (w0 + w1) * (w0 + w1);
-
-            if (dn < dp) {
-                x1 = -x1;
-                y1 = -y1;
-                z1 = -z1;
-                w1 = -w1;
-            }
-
-            componentValuesPerFrame.push_back(x1);
-            componentValuesPerFrame.push_back(y1);
-            componentValuesPerFrame.push_back(z1);
-            componentValuesPerFrame.push_back(w1);
-        }
-    }
-
-    void finish(const std::string &name, const bool useSingleKey, const char *interpolation) {
-        glSampler.interpolation = interpolation;
-
-        if (!m_outputs) {
-            auto &componentValuesPerFrame = componentValuesPerFrameTable.at(0);
-
-            if (useSingleKey) {
-                componentValuesPerFrame.resize(dimension);
-                glSampler.input = frames.glInput0();
-            } else {
-                glSampler.input = frames.glInputs();
-            }
-
-            if (stepDetectSampleCount > 1 && !useSingleKey) {
-                // Remove all
-            }
-
-            m_outputs = contiguousChannelAccessor(name, span(componentValuesPerFrame), useFloatArray ? 1 : dimension);
-
-            glSampler.output = m_outputs.get();
-
-            // A channel cannot have a name according to the spec.
-            // glChannel.name = name;
-        }
-    }
-
-private:
+    void append(const gsl::span<const float> &components, size_t superSample);
+
+    void appendQuaternion(const gsl::span<const float, 4> &q, size_t superSample);
+
+    // Uses the given CUBICSPLINE keys instead of sampled frames.
+    // The values contain the in-tangents, the values and the out-tangents of each key.
+    void setCubicSplineKeys(std::vector<float> times, std::vector<float> values);
+
+    bool hasCubicSplineKeys() const { return m_isCubicSpline; }
+
+    // Replaces the sampled frames by CUBICSPLINE keys that reproduce all frames within the tolerance.
+    // Keeps the frames when the channel is constant, has steps, or when the keys would not be smaller.
+    // This doesn't use Maya, so it can run on any thread, after all frames are sampled.
+    void fitCubicSplineKeys(double tolerance);
+
+    // Are all frame samples so far within the constant threshold of the first sample?
+    bool isConstant() const { return m_isConstant; }
+
+    // The component values of the first sample, empty if nothing was sampled yet.
+    gsl::span<const float> firstValues() const { return span(m_firstValues); }
+
+    // The component values of all sampled frames.
+    // While the channel is constant, only the first sample is stored, so this expands it.
+    std::vector<float> componentValues() const;
+
+    // The number of frame intervals that were exported as a step, valid after finish.
+    size_t stepCount() const { return m_stepCount; }
+
+    // The number of exported keys, valid after finish.
+    size_t keyCount() const { return m_keyCount; }
+
+    // Creates the sampler accessors.
+    // Unless a single key is used, each frame interval is classified as a hold, a step or a linear change.
+    // When compactKeys is set, the keys inside holds are dropped, and steps in LINEAR channels get an extra key
+    // just before the jump, otherwise all frames are exported, and steps are only used when all intervals allow it.
+    // When quantizationBits is 8 or 16, LINEAR and STEP outputs within [-1,1] are stored as normalized integers.
+    void finish(const std::string &name, bool useSingleKey, bool compactKeys, int quantizationBits);
+
+  private:
+    // The number of frames in a chunk of stored component values
+    static constexpr size_t chunkFrameCount = 1024;
+
+    typedef std::vector<std::vector<float>> ValueChunks;
+
+    // The component values of the frames, in chunks.
+    // These stay empty as long as the channel is constant.
+    ValueChunks m_chunks;
+
+    // The number of appended frame samples.
+    size_t m_frameCount = 0;
+
+    // For each frame interval, is the value at the start of the interval held at all step-detection super-samples?
+    // Only used when step detection is enabled.
+    std::vector<bool> m_isHeldInterval;
+
+    std::vector<float> m_firstValues;
+    std::vector<float> m_frameValues;
+    std::vector<float> m_lastValues;
+
+    bool m_isConstant = true;
+    bool m_isCubicSpline = false;
+
+    size_t m_stepCount = 0;
+    size_t m_keyCount = 0;
+
+    std::vector<float> m_inputValues;
+    std::vector<float> m_outputValues;
+    std::vector<byte> m_quantizedOutputValues;
+    std::unique_ptr<GLTF::Accessor> m_inputs;
     std::unique_ptr<GLTF::Accessor> m_outputs;
 
+    void store(const gsl::span<const float> &components);
+
+    void expandConstantSamples();
+
+    bool isSame(const float *values1, const float *values2) const;
+
+    // Fills the key times and values, returns false if all frames should be used.
+    bool computeKeys(const std::vector<float> &values, bool compactKeys);
+
     DISALLOW_COPY_MOVE_ASSIGN(PropAnimation);
 };
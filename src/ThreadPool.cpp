@@ -0,0 +1,142 @@
+#include "externals.h"
+
+#include "ThreadPool.h"
+
+// Not a smart pointer, a pool that was never destroyed must not be joined during static destruction
+static ThreadPool *sharedPool = nullptr;
+
+ThreadPool::ThreadPool(const size_t threadCount) {
+    const auto count = threadCount > 0 ? threadCount : std::max<size_t>(std::thread::hardware_concurrency(), 1);
+
+    m_threads.reserve(count);
+    for (size_t index = 0; index < count; ++index) {
+        m_threads.emplace_back([this] { work(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isStopping = true;
+    }
+
+    m_condition.notify_all();
+
+    for (auto &thread : m_threads) {
+        thread.join();
+    }
+}
+
+std::future<void> ThreadPool::enqueue(std::function<void()> task) {
+    std::packaged_task<void()> packagedTask(std::move(task));
+    auto future = packagedTask.get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push(std::move(packagedTask));
+    }
+
+    m_condition.notify_one();
+    return future;
+}
+
+void ThreadPool::parallelFor(const size_t count, const std::function<void(size_t)> &body) {
+    if (count == 0)
+        return;
+
+    // The helpers can still be queued behind other tasks when the caller finished all indices,
+    // so the caller only waits for the helpers that started, the others find the loop closed.
+    // The state outlives this call, since these late helpers still run.
+    struct Loop {
+        std::atomic<size_t> nextIndex{0};
+        std::mutex mutex;
+        std::condition_variable finished;
+        size_t runningCount = 0;
+        bool isClosed = false;
+        std::exception_ptr firstException;
+    };
+
+    const auto loop = std::make_shared<Loop>();
+
+    // The workers pull the next index, so uneven work is balanced.
+    const auto run = [&body, count](Loop &state) {
+        try {
+            for (auto index = state.nextIndex++; index < count; index = state.nextIndex++) {
+                body(index);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            if (!state.firstException) {
+                state.firstException = std::current_exception();
+            }
+            // Make the others stop early
+            state.nextIndex = count;
+        }
+    };
+
+    const auto helperCount = std::min(m_threads.size(), count - 1);
+
+    for (size_t index = 0; index < helperCount; ++index) {
+        enqueue([loop, run] {
+            {
+                std::lock_guard<std::mutex> lock(loop->mutex);
+                if (loop->isClosed)
+                    return;
+                ++loop->runningCount;
+            }
+
+            run(*loop);
+
+            {
+                std::lock_guard<std::mutex> lock(loop->mutex);
+                --loop->runningCount;
+            }
+            loop->finished.notify_all();
+        });
+    }
+
+    run(*loop);
+
+    std::unique_lock<std::mutex> lock(loop->mutex);
+    loop->isClosed = true;
+    loop->finished.wait(lock, [&] { return loop->runningCount == 0; });
+
+    if (loop->firstException) {
+        std::rethrow_exception(loop->firstException);
+    }
+}
+
+ThreadPool &ThreadPool::shared() {
+    assert(sharedPool);
+    return *sharedPool;
+}
+
+void ThreadPool::createShared() {
+    if (!sharedPool) {
+        sharedPool = new ThreadPool();
+    }
+}
+
+void ThreadPool::destroyShared() {
+    delete sharedPool;
+    sharedPool = nullptr;
+}
+
+void ThreadPool::work() {
+    for (;;) {
+        std::packaged_task<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_isStopping || !m_tasks.empty(); });
+
+            if (m_isStopping && m_tasks.empty())
+                return;
+
+            task = std::move(m_tasks.front());
+            m_tasks.pop();
+        }
+
+        task();
+    }
+}
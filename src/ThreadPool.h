@@ -0,0 +1,42 @@
+#pragma once
+
+#include "macros.h"
+
+// A fixed set of worker threads, for work that doesn't touch Maya.
+// Maya's API is not thread-safe, so tasks must only use plain data.
+class ThreadPool {
+  public:
+    // Uses one thread per hardware thread when threadCount is 0
+    explicit ThreadPool(size_t threadCount = 0);
+    ~ThreadPool();
+
+    size_t threadCount() const { return m_threads.size(); }
+
+    // Runs the task on a worker thread.
+    // The future rethrows the exception of the task, if any.
+    std::future<void> enqueue(std::function<void()> task);
+
+    // Calls body(index) for each index in [0, count) on the worker threads, and the calling thread.
+    // Blocks until all calls completed, and rethrows the first exception.
+    void parallelFor(size_t count, const std::function<void(size_t)> &body);
+
+    // The pool that is shared by the exporter, see createShared.
+    static ThreadPool &shared();
+
+    // Creates and destroys the shared pool, when the plugin is loaded and unloaded.
+    // Destroying it joins the worker threads, which must not happen during static destruction,
+    // on Windows that runs under the loader lock, and the unloading would hang.
+    static void createShared();
+    static void destroyShared();
+
+  private:
+    DISALLOW_COPY_MOVE_ASSIGN(ThreadPool);
+
+    std::vector<std::thread> m_threads;
+    std::queue<std::packaged_task<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_isStopping = false;
+
+    void work();
+};
@@ -0,0 +1,82 @@
+#include "externals.h"
+
+#include "ExportableClip.h"
+#include "TimelineSampler.h"
+#include "progress.h"
+#include "timeControl.h"
+
+// Maya's time resolution
+const double mayaTicksPerSecond = 141120000;
+
+// The sample times are half a tick after a tick, so flooring is robust against rounding.
+static int64_t toTick(const MTime &time) { return static_cast<int64_t>(std::floor(time.as(MTime::kSeconds) * mayaTicksPerSecond)); }
+
+TimelineSampler::TimelineSampler(const bool redrawViewport) : m_redrawViewport(redrawViewport) {}
+
+void TimelineSampler::add(ExportableClip &clip) {
+    const auto frameCount = clip.frameCount();
+    const auto stepDetectSampleCount = clip.stepDetectSampleCount();
+    const auto requiresTimeline = clip.requiresTimeline();
+
+    m_samples.reserve(m_samples.size() + frameCount * stepDetectSampleCount);
+
+    for (int relativeFrameIndex = 0; relativeFrameIndex < frameCount; ++relativeFrameIndex) {
+        for (int superSampleIndex = 0; superSampleIndex < stepDetectSampleCount; ++superSampleIndex) {
+            const auto time = clip.sampleTime(relativeFrameIndex, superSampleIndex);
+            m_samples.push_back({toTick(time), time, &clip, relativeFrameIndex, superSampleIndex, requiresTimeline});
+        }
+    }
+}
+
+size_t TimelineSampler::distinctFrameCount(const std::vector<const AnimClipArg *> &clipArgs) {
+    std::vector<int64_t> ticks;
+
+    for (auto clipArg : clipArgs) {
+        const auto frameCount = clipArg->frameCount();
+        for (int relativeFrameIndex = 0; relativeFrameIndex < frameCount; ++relativeFrameIndex) {
+            ticks.push_back(toTick(ExportableClip::frameTime(*clipArg, relativeFrameIndex)));
+        }
+    }
+
+    std::sort(ticks.begin(), ticks.end());
+    return std::unique(ticks.begin(), ticks.end()) - ticks.begin();
+}
+
+size_t TimelineSampler::run() {
+    // The samples of each clip are in time order, a stable sort keeps them so.
+    std::stable_sort(m_samples.begin(), m_samples.end(), [](const Sample &a, const Sample &b) { return a.tick < b.tick; });
+
+    size_t distinctTimeCount = 0;
+    size_t distinctFrameCount = 0;
+
+    for (auto first = m_samples.begin(); first != m_samples.end();) {
+        const auto last =
+            std::find_if(first, m_samples.end(), [tick = first->tick](const Sample &sample) { return sample.tick != tick; });
+
+        const auto requiresTimeline = std::any_of(first, last, [](const Sample &sample) { return sample.requiresTimeline; });
+        const auto isFrame = std::any_of(first, last, [](const Sample &sample) { return sample.superSampleIndex == 0; });
+
+        if (requiresTimeline) {
+            setCurrentTime(first->time, m_redrawViewport && isFrame);
+        }
+
+        // The node transforms are the same for all clips at this time
+        NodeTransformCache transformCache;
+        for (auto it = first; it != last; ++it) {
+            it->clip->sampleAt(it->time, it->relativeFrameIndex, it->superSampleIndex, transformCache);
+        }
+
+        ++distinctTimeCount;
+
+        // Progress is counted in frames, not super-samples
+        if (isFrame && ++distinctFrameCount % checkProgressFrameInterval == 0) {
+            uiAdvanceProgress(formatted("sampling timeline %d%%", static_cast<int>((first - m_samples.begin()) * 100 / m_samples.size())));
+        }
+
+        first = last;
+    }
+
+    m_samples.clear();
+
+    return distinctTimeCount;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "macros.h"
+
+class ExportableClip;
+struct AnimClipArg;
+
+// Samples animation clips in a single pass over the timeline.
+// Clips often overlap, so each distinct time is evaluated only once,
+// and its samples are passed to all clips that contain that time.
+class TimelineSampler {
+  public:
+    explicit TimelineSampler(bool redrawViewport);
+    ~TimelineSampler() = default;
+
+    // The clip must outlive the sampler
+    void add(ExportableClip &clip);
+
+    // Samples all clips, returns the number of distinct times that were evaluated.
+    size_t run();
+
+    // The number of distinct frame times of the clips, run advances the progress each checkProgressFrameInterval of these.
+    static size_t distinctFrameCount(const std::vector<const AnimClipArg *> &clipArgs);
+
+  private:
+    DISALLOW_COPY_MOVE_ASSIGN(TimelineSampler);
+
+    struct Sample {
+        // The time in Maya ticks, to find identical times
+        int64_t tick;
+        MTime time;
+        ExportableClip *clip;
+        int relativeFrameIndex;
+        int superSampleIndex;
+        bool requiresTimeline;
+    };
+
+    const bool m_redrawViewport;
+    std::vector<Sample> m_samples;
+};
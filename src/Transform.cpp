@@ -107,6 +107,30 @@ void makeIdentity(GLTF::Node::TransformTRS &trs) {
     trs.rotation[3] = 1;
 }
 
+MMatrix toMatrix(const GLTF::Node::TransformTRS &trs) {
+    MMatrix scale;
+    scale[0][0] = trs.scale[0];
+    scale[1][1] = trs.scale[1];
+    scale[2][2] = trs.scale[2];
+
+    const MQuaternion rotation(trs.rotation[0], trs.rotation[1], trs.rotation[2], trs.rotation[3]);
+
+    MMatrix translation;
+    translation[3][0] = trs.translation[0];
+    translation[3][1] = trs.translation[1];
+    translation[3][2] = trs.translation[2];
+
+    return scale * rotation.asMatrix() * translation;
+}
+
+void toTRS(const MMatrix &matrix, GLTF::Node::TransformTRS &trs, const double posPrecision, const double sclPrecision,
+           const double dirPrecision) {
+    const MTransformationMatrix mayaMatrix(matrix);
+    getTranslation(mayaMatrix, trs.translation, 1, posPrecision);
+    getRotation(mayaMatrix, trs.rotation, dirPrecision);
+    getScaling(mayaMatrix, trs.scale, sclPrecision);
+}
+
 const NodeTransformState &
 NodeTransformCache::getTransform(const ExportableNode *node,
                                  const double scaleFactor,
@@ -7,6 +7,12 @@ double getAxesNonOrthogonality(const MMatrix &m);
 
 void makeIdentity(GLTF::Node::TransformTRS &trs);
 
+// The matrix of the GLTF transform, using Maya matrix math, so P * M scales, rotates and then translates the point P
+MMatrix toMatrix(const GLTF::Node::TransformTRS &trs);
+
+// Decomposes the matrix into the GLTF transform, rounded to the precisions. The matrix must not be skewed.
+void toTRS(const MMatrix &matrix, GLTF::Node::TransformTRS &trs, double posPrecision, double sclPrecision, double dirPrecision);
+
 class ExportableNode;
 
 /*
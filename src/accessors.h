@@ -53,6 +53,111 @@ contiguousChannelAccessor(const std::string &name,
                               dimension);
 }
 
+// An accessor whose integer components map to [0,1] when unsigned,
+// or to [-1,1] when signed
+class NormalizedAccessor : public GLTF::Accessor {
+  public:
+    using GLTF::Accessor::Accessor;
+
+    void writeJSON(void *writer, GLTF::Options *options) override {
+        auto jsonWriter =
+            static_cast<rapidjson::Writer<rapidjson::StringBuffer> *>(writer);
+        jsonWriter->Key("normalized");
+        jsonWriter->Bool(true);
+        GLTF::Accessor::writeJSON(writer, options);
+    }
+};
+
+template <typename T>
+void quantizeNormalized(const gsl::span<const float> &values,
+                        std::vector<byte> &bytes) {
+    const auto maxValue = static_cast<double>(std::numeric_limits<T>::max());
+
+    bytes.resize(values.size() * sizeof(T));
+    auto components = reinterpret_cast<T *>(bytes.data());
+
+    for (size_t index = 0; index < values.size(); ++index) {
+        components[index] =
+            static_cast<T>(std::round(values[index] * maxValue));
+    }
+}
+
+// Quantizes the components to normalized 8 or 16 bit integers, stored in
+// bytes, which must outlive the accessor. Unsigned integers are used when no
+// component is negative. Returns null when a component is outside [-1,1].
+inline std::unique_ptr<GLTF::Accessor>
+normalizedChannelAccessor(const std::string &name,
+                          const gsl::span<const float> &data,
+                          const size_t dimension, const int bitCount,
+                          std::vector<byte> &bytes) {
+    if (data.empty())
+        return nullptr;
+
+    const auto range = std::minmax_element(data.begin(), data.end());
+    const auto minValue = *range.first;
+    const auto maxValue = *range.second;
+
+    if (minValue < -1 || maxValue > 1)
+        return nullptr;
+
+    const auto isUnsigned = minValue >= 0;
+
+    GLTF::Constants::WebGL componentType;
+
+    if (bitCount <= 8) {
+        if (isUnsigned) {
+            quantizeNormalized<uint8_t>(data, bytes);
+            componentType = GLTF::Constants::WebGL::UNSIGNED_BYTE;
+        } else {
+            quantizeNormalized<int8_t>(data, bytes);
+            componentType = GLTF::Constants::WebGL::BYTE;
+        }
+    } else {
+        if (isUnsigned) {
+            quantizeNormalized<uint16_t>(data, bytes);
+            componentType = GLTF::Constants::WebGL::UNSIGNED_SHORT;
+        } else {
+            quantizeNormalized<int16_t>(data, bytes);
+            componentType = GLTF::Constants::WebGL::SHORT;
+        }
+    }
+
+    auto accessor = std::make_unique<NormalizedAccessor>(
+        glAccessorType(dimension), componentType, bytes.data(),
+        int(data.size() / dimension), static_cast<GLTF::Constants::WebGL>(-1));
+
+    accessor->name = name;
+
+    return accessor;
+}
+
+// A float accessor without buffer view, so all its components are zero.
+// The min and max are written too, these are required for positions.
+class ZeroAccessor : public GLTF::Accessor {
+  public:
+    ZeroAccessor(const std::string &name, const GLTF::Accessor::Type type,
+                 const int count)
+        : GLTF::Accessor(type, GLTF::Constants::WebGL::FLOAT) {
+        this->name = name;
+        this->count = count;
+    }
+
+    void writeJSON(void *writer, GLTF::Options *options) override {
+        auto jsonWriter =
+            static_cast<rapidjson::Writer<rapidjson::StringBuffer> *>(writer);
+        const auto componentCount = getNumberOfComponents();
+        for (auto key : {"min", "max"}) {
+            jsonWriter->Key(key);
+            jsonWriter->StartArray();
+            for (int i = 0; i < componentCount; ++i) {
+                jsonWriter->Int(0);
+            }
+            jsonWriter->EndArray();
+        }
+        GLTF::Accessor::writeJSON(writer, options);
+    }
+};
+
 inline std::unique_ptr<GLTF::Accessor> contiguousElementAccessor(
     const std::string &name, const Semantic::Kind semantic,
     const ShapeIndex &shapeIndex, const gsl::span<const byte> &bytes) {
@@ -0,0 +1,68 @@
+#include "externals.h"
+
+#include "atlasLayout.h"
+
+AtlasLayout::AtlasLayout(const std::vector<std::pair<int, int>> &tileSizes, const int maxAtlasSize) : m_tiles(tileSizes.size()) {
+    // The tallest tiles first, so each shelf wastes little height
+    std::vector<size_t> order(tileSizes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](const size_t a, const size_t b) {
+        return std::tie(tileSizes[a].second, tileSizes[a].first) > std::tie(tileSizes[b].second, tileSizes[b].first);
+    });
+
+    int shelfX = 0;
+    int shelfY = 0;
+    int shelfHeight = 0;
+
+    for (const auto index : order) {
+        const auto width = tileSizes[index].first;
+        const auto height = tileSizes[index].second;
+        assert(width <= maxAtlasSize && height <= maxAtlasSize);
+
+        if (m_atlasSizes.empty() || shelfX + width > maxAtlasSize) {
+            // Start a new shelf, or a new atlas when it doesn't fit below the current shelf
+            shelfX = 0;
+            shelfY += shelfHeight;
+            shelfHeight = 0;
+
+            if (m_atlasSizes.empty() || shelfY + height > maxAtlasSize) {
+                m_atlasSizes.emplace_back(0, 0);
+                shelfY = 0;
+            }
+        }
+
+        auto &tile = m_tiles[index];
+        tile.atlasIndex = m_atlasSizes.size() - 1;
+        tile.x = shelfX;
+        tile.y = shelfY;
+
+        shelfX += width;
+        shelfHeight = std::max(shelfHeight, height);
+
+        auto &atlasSize = m_atlasSizes.back();
+        atlasSize.first = std::max(atlasSize.first, shelfX);
+        atlasSize.second = std::max(atlasSize.second, shelfY + height);
+    }
+
+    for (auto &atlasSize : m_atlasSizes) {
+        atlasSize.first = (atlasSize.first + 3) & ~3;
+        atlasSize.second = (atlasSize.second + 3) & ~3;
+    }
+}
+
+void blitPaddedRGBA8(const uint8_t *source, const int sourceWidth, const int sourceHeight, uint8_t *target, const int targetWidth,
+                     const int x, const int y, const int padding) {
+    const auto sourceRowSize = static_cast<size_t>(sourceWidth) * 4;
+
+    for (int row = -padding; row < sourceHeight + padding; ++row) {
+        const auto sourceRow = source + std::clamp(row, 0, sourceHeight - 1) * sourceRowSize;
+        auto targetRow = target + (static_cast<size_t>(y + padding + row) * targetWidth + x + padding) * 4;
+
+        std::memcpy(targetRow, sourceRow, sourceRowSize);
+
+        for (int column = 1; column <= padding; ++column) {
+            std::memcpy(targetRow - column * 4, sourceRow, 4);
+            std::memcpy(targetRow + sourceRowSize + (column - 1) * 4, sourceRow + sourceRowSize - 4, 4);
+        }
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+// The placement of a tile in one of the atlases
+struct AtlasTile {
+    size_t atlasIndex = 0;
+    int x = 0;
+    int y = 0;
+};
+
+// Places rectangular tiles into as few atlases as possible, on shelves sorted by height.
+// Doesn't use Maya, so it can run on any thread.
+class AtlasLayout {
+  public:
+    // The tiles must not be larger than the maximum atlas size.
+    AtlasLayout(const std::vector<std::pair<int, int>> &tileSizes, int maxAtlasSize);
+
+    // The placement of each tile, in the order of the tile sizes
+    const std::vector<AtlasTile> &tiles() const { return m_tiles; }
+
+    // The width and height of each atlas, a multiple of 4 for block compression
+    const std::vector<std::pair<int, int>> &atlasSizes() const { return m_atlasSizes; }
+
+  private:
+    std::vector<AtlasTile> m_tiles;
+    std::vector<std::pair<int, int>> m_atlasSizes;
+};
+
+// Copies the RGBA source image into the target image at x,y, surrounded by a border of repeated edge pixels,
+// so filtering near the edges doesn't bleed in the neighboring tiles.
+void blitPaddedRGBA8(const uint8_t *source, int sourceWidth, int sourceHeight, uint8_t *target, int targetWidth, int x, int y,
+                     int padding);
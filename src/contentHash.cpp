@@ -0,0 +1,192 @@
+#include "externals.h"
+
+#include "contentHash.h"
+
+// See https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+static constexpr uint64_t prime1 = 11400714785074694791ULL;
+static constexpr uint64_t prime2 = 14029467366897019727ULL;
+static constexpr uint64_t prime3 = 1609587929392839161ULL;
+static constexpr uint64_t prime4 = 9650029242287828579ULL;
+static constexpr uint64_t prime5 = 2870177450012600261ULL;
+
+static uint64_t rotateLeft(const uint64_t value, const int bits) { return (value << bits) | (value >> (64 - bits)); }
+
+static uint64_t read64(const uint8_t *bytes) {
+    uint64_t value = 0;
+    for (int i = 8; --i >= 0;) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+static uint64_t read32(const uint8_t *bytes) {
+    uint64_t value = 0;
+    for (int i = 4; --i >= 0;) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+static uint64_t round(uint64_t lane, const uint64_t input) {
+    lane += input * prime2;
+    lane = rotateLeft(lane, 31);
+    return lane * prime1;
+}
+
+static uint64_t mergeLane(const uint64_t hash, const uint64_t lane) { return (hash ^ round(0, lane)) * prime1 + prime4; }
+
+static void consumeStripe(uint64_t lanes[4], const uint8_t *stripe) {
+    for (int i = 0; i < 4; ++i) {
+        lanes[i] = round(lanes[i], read64(stripe + i * 8));
+    }
+}
+
+ContentHash::ContentHash(const uint64_t seed)
+    : m_lanes{seed + prime1 + prime2, seed + prime2, seed, seed - prime1}, m_pending{}, m_seed(seed) {}
+
+void ContentHash::append(const void *data, size_t byteCount) {
+    auto bytes = static_cast<const uint8_t *>(data);
+    m_totalCount += byteCount;
+
+    if (m_pendingCount) {
+        const auto count = std::min(byteCount, sizeof(m_pending) - m_pendingCount);
+        memcpy(m_pending + m_pendingCount, bytes, count);
+        m_pendingCount += count;
+        bytes += count;
+        byteCount -= count;
+
+        if (m_pendingCount < sizeof(m_pending))
+            return;
+
+        consumeStripe(m_lanes, m_pending);
+        m_pendingCount = 0;
+    }
+
+    for (; byteCount >= sizeof(m_pending); bytes += sizeof(m_pending), byteCount -= sizeof(m_pending)) {
+        consumeStripe(m_lanes, bytes);
+    }
+
+    memcpy(m_pending, bytes, byteCount);
+    m_pendingCount = byteCount;
+}
+
+uint64_t ContentHash::value() const {
+    uint64_t hash;
+
+    if (m_totalCount >= sizeof(m_pending)) {
+        hash = rotateLeft(m_lanes[0], 1) + rotateLeft(m_lanes[1], 7) + rotateLeft(m_lanes[2], 12) + rotateLeft(m_lanes[3], 18);
+        for (const auto lane : m_lanes) {
+            hash = mergeLane(hash, lane);
+        }
+    } else {
+        hash = m_seed + prime5;
+    }
+
+    hash += m_totalCount;
+
+    const uint8_t *bytes = m_pending;
+    auto remaining = m_pendingCount;
+
+    for (; remaining >= 8; bytes += 8, remaining -= 8) {
+        hash ^= round(0, read64(bytes));
+        hash = rotateLeft(hash, 27) * prime1 + prime4;
+    }
+
+    if (remaining >= 4) {
+        hash ^= read32(bytes) * prime1;
+        hash = rotateLeft(hash, 23) * prime2 + prime3;
+        bytes += 4;
+        remaining -= 4;
+    }
+
+    for (; remaining > 0; ++bytes, --remaining) {
+        hash ^= *bytes * prime5;
+        hash = rotateLeft(hash, 11) * prime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+uint64_t ContentHash::ofFile(const std::string &path, uint64_t *byteCount) {
+    std::ifstream stream(path, std::ios::in | std::ios::binary);
+    if (!stream)
+        throw std::runtime_error("Couldn't open '" + path + "'");
+
+    ContentHash hash;
+    std::vector<char> chunk(1 << 20);
+    while (stream) {
+        stream.read(chunk.data(), chunk.size());
+        hash.append(chunk.data(), stream.gcount());
+    }
+
+    if (byteCount) {
+        *byteCount = hash.m_totalCount;
+    }
+
+    return hash.value();
+}
+
+static fs::path indexEntryPath(const fs::path &indexFolder, const std::string &pathString) {
+    return indexFolder / (ContentHash::hex(ContentHash::of(pathString.data(), pathString.size())) + ".txt");
+}
+
+static void writeIndexEntry(const fs::path &indexFolder, const std::string &pathString, const uint64_t size, const int64_t time,
+                            const uint64_t hash) {
+    const auto indexPath = indexEntryPath(indexFolder, pathString);
+
+    // Each thread writes its own file first, so readers never see a partial entry.
+    // The index is only a cache, so an entry that can't be written is hashed again next time.
+    std::ostringstream partialSuffix;
+    partialSuffix << '.' << std::this_thread::get_id() << ".partial";
+    auto partialPath = indexPath;
+    partialPath += partialSuffix.str();
+
+    std::error_code error;
+    create_directories(indexFolder, error);
+    std::ofstream(partialPath.generic_string()) << pathString << '\n' << size << ' ' << time << ' ' << hash << '\n';
+    rename(partialPath, indexPath, error);
+    if (error) {
+        remove(partialPath, error);
+    }
+}
+
+uint64_t ContentHash::ofIndexedFile(const fs::path &indexFolder, const fs::path &path, uint64_t *byteCount) {
+    const auto size = file_size(path);
+    const int64_t time = last_write_time(path).time_since_epoch().count();
+
+    const auto pathString = path.generic_string();
+    const auto indexPath = indexEntryPath(indexFolder, pathString);
+
+    std::ifstream indexFile(indexPath.generic_string());
+    std::string indexedPath;
+    uint64_t indexedSize;
+    int64_t indexedTime;
+    uint64_t indexedHash;
+    if (std::getline(indexFile, indexedPath) && indexFile >> indexedSize >> indexedTime >> indexedHash && indexedPath == pathString &&
+        indexedSize == size && indexedTime == time) {
+        if (byteCount) {
+            *byteCount = indexedSize;
+        }
+        return indexedHash;
+    }
+    indexFile.close();
+
+    const auto hash = ofFile(pathString, byteCount);
+    writeIndexEntry(indexFolder, pathString, size, time, hash);
+    return hash;
+}
+
+void ContentHash::addToIndex(const fs::path &indexFolder, const fs::path &path, const uint64_t hash) {
+    writeIndexEntry(indexFolder, path.generic_string(), file_size(path), last_write_time(path).time_since_epoch().count(), hash);
+}
+
+std::string ContentHash::hex(const uint64_t hash) {
+    std::ostringstream ss;
+    ss << std::hex << std::setfill('0') << std::setw(16) << hash;
+    return ss.str();
+}
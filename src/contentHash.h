@@ -0,0 +1,41 @@
+#pragma once
+
+#include "filesystem.h"
+
+// A streaming 64-bit XXH64 hash of file contents.
+// Much faster than SHA-256, but not meant to be secure.
+class ContentHash {
+  public:
+    explicit ContentHash(uint64_t seed = 0);
+
+    void append(const void *data, size_t byteCount);
+
+    // The hash of all appended bytes
+    uint64_t value() const;
+
+    // The hash as 16 lowercase hexadecimal digits
+    static std::string hex(uint64_t hash);
+
+    static uint64_t of(const void *data, const size_t byteCount) {
+        ContentHash hash;
+        hash.append(data, byteCount);
+        return hash.value();
+    }
+
+    // Hashes the file in chunks, and counts its bytes when byteCount is given. Throws if the file can't be read.
+    static uint64_t ofFile(const std::string &path, uint64_t *byteCount = nullptr);
+
+    // Like ofFile, but remembers the hash in the index folder by path, size and modification time, so an unchanged file is not read again.
+    // Can be called from any thread.
+    static uint64_t ofIndexedFile(const fs::path &indexFolder, const fs::path &path, uint64_t *byteCount = nullptr);
+
+    // Remembers the known hash of a file that was just written, e.g. a copy, so ofIndexedFile doesn't need to read it.
+    static void addToIndex(const fs::path &indexFolder, const fs::path &path, uint64_t hash);
+
+  private:
+    uint64_t m_lanes[4];
+    uint8_t m_pending[32];
+    size_t m_pendingCount = 0;
+    uint64_t m_totalCount = 0;
+    uint64_t m_seed;
+};
@@ -2,11 +2,13 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <bitset>
 #include <cassert>
 #include <cctype>
 #include <cerrno>
 #include <chrono>
+#include <condition_variable>
 #include <climits>
 #include <cmath>
 #include <csignal>
@@ -15,14 +17,20 @@
 #include <cstdlib>
 #include <cstring>
 #include <fstream>
+#include <functional>
+#include <future>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <numeric>
+#include <queue>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <thread>
+#include <tuple>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -72,8 +80,10 @@
 #include <maya/MDagModifier.h>
 #include <maya/MDagPath.h>
 #include <maya/MDagPathArray.h>
+#include <maya/MEulerRotation.h>
 #include <maya/MFileIO.h>
 #include <maya/MFileObject.h>
+#include <maya/MFnAnimCurve.h>
 #include <maya/MFloatMatrix.h>
 #include <maya/MFloatPointArray.h>
 #include <maya/MFloatVectorArray.h>
@@ -82,6 +92,7 @@
 #include <maya/MFnBlinnShader.h>
 #include <maya/MFnCamera.h>
 #include <maya/MFnComponentListData.h>
+#include <maya/MFnIkHandle.h>
 #include <maya/MFnLambertShader.h>
 #include <maya/MFnMatrixData.h>
 #include <maya/MFnMesh.h>
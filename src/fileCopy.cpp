@@ -0,0 +1,115 @@
+#include "externals.h"
+
+#include "contentHash.h"
+#include "dump.h"
+#include "fileCopy.h"
+
+#ifdef LINUX
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif __APPLE__
+#include <copyfile.h>
+#endif
+
+static bool isUpToDate(const fs::path &source, const fs::path &target, const fs::path &hashIndexFolder) {
+    std::error_code error;
+    if (!exists(target, error))
+        return false;
+
+    // A hard link to the source is always up-to-date
+    if (equivalent(source, target, error))
+        return true;
+
+    return file_size(source) == file_size(target, error) && last_write_time(source) == last_write_time(target, error) &&
+           ContentHash::ofIndexedFile(hashIndexFolder, source) == ContentHash::ofIndexedFile(hashIndexFolder, target);
+}
+
+#ifdef LINUX
+static void copyFileData(const fs::path &source, const fs::path &target) {
+    const int sourceFile = open(source.c_str(), O_RDONLY | O_CLOEXEC);
+    if (sourceFile < 0)
+        throw std::runtime_error(formatted("Couldn't read '%s': %s", source.c_str(), strerror(errno)));
+
+    struct stat sourceStat;
+    fstat(sourceFile, &sourceStat);
+
+    const int targetFile = open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, sourceStat.st_mode & 0777);
+    if (targetFile < 0) {
+        const auto targetError = errno;
+        close(sourceFile);
+        throw std::runtime_error(formatted("Couldn't write to '%s': %s", target.c_str(), strerror(targetError)));
+    }
+
+    off_t remaining = sourceStat.st_size;
+
+#ifdef FICLONE
+    // Share the data blocks when the file system supports it (btrfs, xfs)
+    if (ioctl(targetFile, FICLONE, sourceFile) == 0) {
+        remaining = 0;
+    }
+#endif
+
+#ifdef SYS_copy_file_range
+    // Copies inside the kernel, or even on the server with network file systems.
+    // Older kernels don't support this across file systems, then sendfile takes over.
+    while (remaining > 0) {
+        const auto count = syscall(SYS_copy_file_range, sourceFile, nullptr, targetFile, nullptr, remaining, 0u);
+        if (count <= 0)
+            break;
+        remaining -= count;
+    }
+#endif
+
+    // Both file offsets were advanced by the copied part, so sendfile continues from there.
+    while (remaining > 0) {
+        const auto count = sendfile(targetFile, sourceFile, nullptr, remaining);
+        if (count <= 0)
+            break;
+        remaining -= count;
+    }
+
+    const auto copyError = errno;
+    close(sourceFile);
+    close(targetFile);
+
+    if (remaining > 0)
+        throw std::runtime_error(formatted("Couldn't copy '%s' to '%s': %s", source.c_str(), target.c_str(), strerror(copyError)));
+}
+#elif defined(__APPLE__) && defined(COPYFILE_CLONE)
+static void copyFileData(const fs::path &source, const fs::path &target) {
+    // Clones the file on APFS, copies it otherwise. Cloning requires the target to be absent, see copyFile.
+    if (copyfile(source.c_str(), target.c_str(), nullptr, COPYFILE_CLONE) != 0)
+        throw std::runtime_error(formatted("Couldn't copy '%s' to '%s': %s", source.c_str(), target.c_str(), strerror(errno)));
+}
+#else
+static void copyFileData(const fs::path &source, const fs::path &target) {
+    // On Windows this uses CopyFile, which copies inside the kernel.
+    copy_file(source, target, fs::copy_options::overwrite_existing);
+}
+#endif
+
+bool copyFile(const fs::path &source, const fs::path &target, const FileCopyMode mode, const fs::path &hashIndexFolder) {
+    if (isUpToDate(source, target, hashIndexFolder))
+        return false;
+
+    // Never write into an existing target, it can be a hard link to a source file of an earlier export,
+    // which the copy would overwrite. Removing it only removes that link.
+    std::error_code error;
+    remove(target, error);
+
+    if (mode == FileCopyMode::Link) {
+        create_hard_link(source, target, error);
+        if (!error)
+            return true;
+    }
+
+    copyFileData(source, target);
+    last_write_time(target, last_write_time(source));
+    ContentHash::addToIndex(hashIndexFolder, target, ContentHash::ofIndexedFile(hashIndexFolder, source));
+    return true;
+}
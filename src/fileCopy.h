@@ -0,0 +1,17 @@
+#pragma once
+
+#include "filesystem.h"
+
+enum class FileCopyMode {
+    // Copies the data, sharing it when the file system supports reflinks
+    Copy,
+    // Creates a hard link when the source and target are on the same file system, copies otherwise
+    Link
+};
+
+// Copies the source file to the target file, letting the kernel move the data.
+// Skips the copy when the target already has the same size, modification time and content hash.
+// The hashes come from the index in the given folder, see ContentHash::ofIndexedFile, so unchanged files are not read.
+// The target gets the modification time and the indexed hash of the source, so the next copy can be skipped.
+// Returns false if the copy was skipped. Doesn't use Maya, so it can run on any thread.
+bool copyFile(const fs::path &source, const fs::path &target, FileCopyMode mode, const fs::path &hashIndexFolder);
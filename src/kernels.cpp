@@ -0,0 +1,352 @@
+#include "externals.h"
+
+#include "BasicTypes.h"
+#include "kernels.h"
+
+// MSVC never defines __SSE4_1__, nor __SSE2__, but always allows the intrinsics on x64.
+// Maya requires a CPU with SSE4.2, so the SSE4.1 kernels are used there too.
+#if defined(__SSE4_1__) || defined(__AVX__) || (defined(_MSC_VER) && defined(_M_X64))
+#define KERNELS_SSE4_1
+#endif
+
+#if defined(KERNELS_SSE4_1) || defined(__SSE2__) || defined(_M_X64)
+#define KERNELS_SSE2
+#endif
+
+#if defined(KERNELS_SSE2)
+#include <immintrin.h>
+#endif
+
+namespace kernels {
+#if defined(__AVX2__)
+// Same as roundToFloat: round(v * precision) / precision, rounding halves away from zero, without -0
+static __m128 scaleRoundToFloats(const __m128 source, const __m256d scale, const __m256d precision) {
+    const auto half = _mm256_set1_pd(0.5);
+    const auto one = _mm256_set1_pd(1.0);
+    const auto signMask = _mm256_set1_pd(-0.0);
+
+    const auto x = _mm256_mul_pd(_mm256_mul_pd(_mm256_cvtps_pd(source), scale), precision);
+    const auto t = _mm256_round_pd(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    const auto f = _mm256_andnot_pd(signMask, _mm256_sub_pd(x, t));
+    const auto away = _mm256_and_pd(_mm256_cmp_pd(f, half, _CMP_GE_OQ), _mm256_or_pd(one, _mm256_and_pd(signMask, x)));
+    const auto r = _mm256_div_pd(_mm256_add_pd(t, away), precision);
+    return _mm_add_ps(_mm256_cvtpd_ps(r), _mm_setzero_ps());
+}
+#elif defined(KERNELS_SSE4_1)
+static __m128 scaleRoundToFloats(const __m128 source, const __m128d scale, const __m128d precision) {
+    const auto half = _mm_set1_pd(0.5);
+    const auto one = _mm_set1_pd(1.0);
+    const auto signMask = _mm_set1_pd(-0.0);
+
+    const auto x = _mm_mul_pd(_mm_mul_pd(_mm_cvtps_pd(source), scale), precision);
+    const auto t = _mm_round_pd(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    const auto f = _mm_andnot_pd(signMask, _mm_sub_pd(x, t));
+    const auto away = _mm_and_pd(_mm_cmpge_pd(f, half), _mm_or_pd(one, _mm_and_pd(signMask, x)));
+    const auto r = _mm_div_pd(_mm_add_pd(t, away), precision);
+    return _mm_add_ps(_mm_cvtpd_ps(r), _mm_setzero_ps());
+}
+#endif
+
+void scaleRoundToFloats(const float *source, float *target, const size_t count, const double scale,
+                        const double precision) {
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    const auto scale4 = _mm256_set1_pd(scale);
+    const auto precision4 = _mm256_set1_pd(precision);
+
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(target + i, scaleRoundToFloats(_mm_loadu_ps(source + i), scale4, precision4));
+    }
+#elif defined(KERNELS_SSE4_1)
+    const auto scale2 = _mm_set1_pd(scale);
+    const auto precision2 = _mm_set1_pd(precision);
+
+    for (; i + 2 <= count; i += 2) {
+        const auto source2 = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double *>(source + i)));
+        _mm_store_sd(reinterpret_cast<double *>(target + i),
+                     _mm_castps_pd(scaleRoundToFloats(source2, scale2, precision2)));
+    }
+#endif
+
+    for (; i < count; ++i) {
+        target[i] = roundToFloat(source[i] * scale, precision);
+    }
+}
+
+void interleaveFlippedUVs(const float *u, const float *v, float *target, const size_t count) {
+    size_t i = 0;
+
+#if defined(KERNELS_SSE2)
+    const auto one = _mm_set1_ps(1.0f);
+
+    for (; i + 4 <= count; i += 4) {
+        const auto u4 = _mm_loadu_ps(u + i);
+        const auto v4 = _mm_sub_ps(one, _mm_loadu_ps(v + i));
+        _mm_storeu_ps(target + 2 * i, _mm_unpacklo_ps(u4, v4));
+        _mm_storeu_ps(target + 2 * i + 4, _mm_unpackhi_ps(u4, v4));
+    }
+#endif
+
+    for (; i < count; ++i) {
+        target[2 * i + 0] = u[i];
+        target[2 * i + 1] = 1 - v[i];
+    }
+}
+
+float subtractDeltas(const float *source, const size_t sourceDimension, float *target, const size_t targetDimension,
+                     const size_t elementCount) {
+    float maxAbsDelta = 0;
+
+    if (sourceDimension == targetDimension) {
+        // The same layout, so subtract all components at once
+        const auto count = elementCount * targetDimension;
+
+        size_t i = 0;
+
+#if defined(__AVX2__)
+        const auto signMask8 = _mm256_set1_ps(-0.0f);
+        auto maxAbs8 = _mm256_setzero_ps();
+
+        for (; i + 8 <= count; i += 8) {
+            const auto delta = _mm256_sub_ps(_mm256_loadu_ps(target + i), _mm256_loadu_ps(source + i));
+            _mm256_storeu_ps(target + i, delta);
+            maxAbs8 = _mm256_max_ps(maxAbs8, _mm256_andnot_ps(signMask8, delta));
+        }
+
+        alignas(32) float maxAbs[8];
+        _mm256_store_ps(maxAbs, maxAbs8);
+        maxAbsDelta = *std::max_element(maxAbs, maxAbs + 8);
+#elif defined(KERNELS_SSE2)
+        const auto signMask4 = _mm_set1_ps(-0.0f);
+        auto maxAbs4 = _mm_setzero_ps();
+
+        for (; i + 4 <= count; i += 4) {
+            const auto delta = _mm_sub_ps(_mm_loadu_ps(target + i), _mm_loadu_ps(source + i));
+            _mm_storeu_ps(target + i, delta);
+            maxAbs4 = _mm_max_ps(maxAbs4, _mm_andnot_ps(signMask4, delta));
+        }
+
+        alignas(16) float maxAbs[4];
+        _mm_store_ps(maxAbs, maxAbs4);
+        maxAbsDelta = *std::max_element(maxAbs, maxAbs + 4);
+#endif
+
+        for (; i < count; ++i) {
+            target[i] -= source[i];
+            maxAbsDelta = std::max(maxAbsDelta, std::abs(target[i]));
+        }
+    } else {
+        const auto sharedDimension = std::min(sourceDimension, targetDimension);
+
+        for (size_t element = 0; element < elementCount; ++element) {
+            const auto *s = source + element * sourceDimension;
+            auto *t = target + element * targetDimension;
+
+            for (size_t dimension = 0; dimension < sharedDimension; ++dimension) {
+                t[dimension] -= s[dimension];
+                maxAbsDelta = std::max(maxAbsDelta, std::abs(t[dimension]));
+            }
+        }
+    }
+
+    return maxAbsDelta;
+}
+
+// The source pixels covered by each target pixel, with the covered fraction of each source pixel as weight.
+struct BoxFilter {
+    std::vector<size_t> firsts;
+    std::vector<size_t> offsets;
+    std::vector<float> weights;
+
+    BoxFilter(const size_t sourceCount, const size_t targetCount) {
+        const auto ratio = static_cast<double>(sourceCount) / targetCount;
+
+        firsts.reserve(targetCount);
+        offsets.reserve(targetCount + 1);
+
+        for (size_t t = 0; t < targetCount; ++t) {
+            const auto start = t * ratio;
+            const auto end = std::min((t + 1) * ratio, static_cast<double>(sourceCount));
+            const auto first = static_cast<size_t>(start);
+
+            firsts.push_back(first);
+            offsets.push_back(weights.size());
+
+            for (auto s = first; s < end; ++s) {
+                const auto coverage = std::min(end, s + 1.0) - std::max(start, static_cast<double>(s));
+                weights.push_back(static_cast<float>(coverage / ratio));
+            }
+        }
+
+        offsets.push_back(weights.size());
+    }
+
+    size_t count(const size_t t) const { return offsets[t + 1] - offsets[t]; }
+    const float *weightsOf(const size_t t) const { return weights.data() + offsets[t]; }
+};
+
+static const std::array<float, 256> &srgbToLinearTable() {
+    static const auto table = [] {
+        std::array<float, 256> result;
+        for (size_t i = 0; i < result.size(); ++i) {
+            const auto c = i / 255.0;
+            result[i] = static_cast<float>(c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+        }
+        return result;
+    }();
+    return table;
+}
+
+// Indexed by the linear value in 16-bit fixed point
+static const std::vector<uint8_t> &linearToSrgbTable() {
+    static const auto table = [] {
+        std::vector<uint8_t> result(65536);
+        for (size_t i = 0; i < result.size(); ++i) {
+            const auto c = i / 65535.0;
+            const auto s = c <= 0.0031308 ? c * 12.92 : 1.055 * std::pow(c, 1 / 2.4) - 0.055;
+            result[i] = static_cast<uint8_t>(std::lround(s * 255));
+        }
+        return result;
+    }();
+    return table;
+}
+
+// Adds the weighted source floats to the target floats
+static void accumulate(float *target, const float *source, const float weight, const size_t count) {
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    const auto weight8 = _mm256_set1_ps(weight);
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(target + i, _mm256_add_ps(_mm256_loadu_ps(target + i), _mm256_mul_ps(weight8, _mm256_loadu_ps(source + i))));
+    }
+#elif defined(KERNELS_SSE2)
+    const auto weight4 = _mm_set1_ps(weight);
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(target + i, _mm_add_ps(_mm_loadu_ps(target + i), _mm_mul_ps(weight4, _mm_loadu_ps(source + i))));
+    }
+#endif
+
+    for (; i < count; ++i) {
+        target[i] += weight * source[i];
+    }
+}
+
+// Converts a source row to linear floats, and filters it horizontally
+static void filterRow(const uint8_t *source, const size_t sourceWidth, const BoxFilter &filter, const bool isSRGB,
+                      std::vector<float> &linearRow, float *target) {
+    const auto &srgbToLinear = srgbToLinearTable();
+
+    for (size_t i = 0; i < sourceWidth * 4; i += 4) {
+        for (size_t c = 0; c < 3; ++c) {
+            linearRow[i + c] = isSRGB ? srgbToLinear[source[i + c]] : source[i + c] / 255.0f;
+        }
+        linearRow[i + 3] = source[i + 3] / 255.0f;
+    }
+
+    const auto targetWidth = filter.firsts.size();
+    for (size_t t = 0; t < targetWidth; ++t) {
+        const auto *pixel = linearRow.data() + filter.firsts[t] * 4;
+        const auto *weights = filter.weightsOf(t);
+        const auto count = filter.count(t);
+
+#if defined(KERNELS_SSE2)
+        // One RGBA pixel per SSE register
+        auto sum = _mm_setzero_ps();
+        for (size_t i = 0; i < count; ++i) {
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[i]), _mm_loadu_ps(pixel + i * 4)));
+        }
+        _mm_storeu_ps(target + t * 4, sum);
+#else
+        std::fill(target + t * 4, target + t * 4 + 4, 0.0f);
+        for (size_t i = 0; i < count; ++i) {
+            accumulate(target + t * 4, pixel + i * 4, weights[i], 4);
+        }
+#endif
+    }
+}
+
+void downsampleRGBA8(const uint8_t *source, const size_t sourceWidth, const size_t sourceHeight, uint8_t *target,
+                     const size_t targetWidth, const size_t targetHeight, const bool isSRGB) {
+    const BoxFilter horizontal(sourceWidth, targetWidth);
+    const BoxFilter vertical(sourceHeight, targetHeight);
+
+    const auto rowSize = targetWidth * 4;
+
+    std::vector<float> linearRow(sourceWidth * 4);
+    std::vector<float> filteredRow(rowSize);
+    std::vector<float> sum(rowSize);
+
+    // A source row covered by two target rows is only filtered once.
+    size_t filteredRowIndex = SIZE_MAX;
+
+    const auto &linearToSrgb = linearToSrgbTable();
+
+    for (size_t y = 0; y < targetHeight; ++y) {
+        std::fill(sum.begin(), sum.end(), 0.0f);
+
+        const auto *weights = vertical.weightsOf(y);
+        for (size_t i = 0; i < vertical.count(y); ++i) {
+            const auto sourceRowIndex = vertical.firsts[y] + i;
+            if (sourceRowIndex != filteredRowIndex) {
+                filterRow(source + sourceRowIndex * sourceWidth * 4, sourceWidth, horizontal, isSRGB, linearRow, filteredRow.data());
+                filteredRowIndex = sourceRowIndex;
+            }
+            accumulate(sum.data(), filteredRow.data(), weights[i], rowSize);
+        }
+
+        auto *targetRow = target + y * rowSize;
+        for (size_t i = 0; i < rowSize; i += 4) {
+            for (size_t c = 0; c < 4; ++c) {
+                const auto value = std::min(std::max(sum[i + c], 0.0f), 1.0f);
+                targetRow[i + c] = isSRGB && c < 3 ? linearToSrgb[std::lround(value * 65535)]
+                                                   : static_cast<uint8_t>(std::lround(value * 255));
+            }
+        }
+    }
+}
+
+void packORM(const uint8_t *occlusion, const uint8_t *roughness, const uint8_t *metallic, uint8_t *target, const size_t pixelCount) {
+    size_t i = 0;
+
+    // Each channel is one byte of a little-endian 32-bit pixel.
+#if defined(__AVX2__)
+    const auto red8 = _mm256_set1_epi32(0x000000ff);
+    const auto green8 = _mm256_set1_epi32(0x0000ff00);
+    const auto blue8 = _mm256_set1_epi32(0x00ff0000);
+    const auto alpha8 = _mm256_set1_epi32(static_cast<int>(0xff000000));
+
+    for (; i + 8 <= pixelCount; i += 8) {
+        const auto offset = i * 4;
+        const auto r = occlusion ? _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(occlusion + offset)), red8) : red8;
+        const auto g = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(roughness + offset)), green8);
+        const auto b = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(metallic + offset)), blue8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(target + offset), _mm256_or_si256(_mm256_or_si256(r, g), _mm256_or_si256(b, alpha8)));
+    }
+#endif
+
+#if defined(KERNELS_SSE2)
+    const auto red4 = _mm_set1_epi32(0x000000ff);
+    const auto green4 = _mm_set1_epi32(0x0000ff00);
+    const auto blue4 = _mm_set1_epi32(0x00ff0000);
+    const auto alpha4 = _mm_set1_epi32(static_cast<int>(0xff000000));
+
+    for (; i + 4 <= pixelCount; i += 4) {
+        const auto offset = i * 4;
+        const auto r = occlusion ? _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(occlusion + offset)), red4) : red4;
+        const auto g = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(roughness + offset)), green4);
+        const auto b = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(metallic + offset)), blue4);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(target + offset), _mm_or_si128(_mm_or_si128(r, g), _mm_or_si128(b, alpha4)));
+    }
+#endif
+
+    for (; i < pixelCount; ++i) {
+        const auto offset = i * 4;
+        target[offset + 0] = occlusion ? occlusion[offset + 0] : 255;
+        target[offset + 1] = roughness[offset + 1];
+        target[offset + 2] = metallic[offset + 2];
+        target[offset + 3] = 255;
+    }
+}
+} // namespace kernels
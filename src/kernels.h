@@ -0,0 +1,30 @@
+#pragma once
+
+// Batch versions of the per-component conversions used when copying Maya data.
+// These produce exactly the same floats as the scalar code, using AVX2,
+// SSE4.1 or SSE2 when the compiler targets these, and plain loops otherwise.
+namespace kernels {
+// target[i] = roundToFloat(source[i] * scale, precision)
+// The source and target can be the same array.
+void scaleRoundToFloats(const float *source, float *target, size_t count, double scale, double precision);
+
+// Interleaves the U and V arrays into UV pairs, flipping V to 1-V.
+void interleaveFlippedUVs(const float *u, const float *v, float *target, size_t count);
+
+// Subtracts the source elements from the target elements, turning these into deltas.
+// Only the components shared by both dimensions are subtracted, e.g. the main shape
+// has 4D tangents, and the blend shape targets have 3D ones.
+// Returns the maximum absolute delta component.
+float subtractDeltas(const float *source, size_t sourceDimension, float *target, size_t targetDimension,
+                     size_t elementCount);
+
+// Downscales the RGBA image with a box filter, averaging all source pixels covered by a target pixel.
+// When isSRGB is set, the RGB channels are averaged in linear space. Alpha is always linear.
+void downsampleRGBA8(const uint8_t *source, size_t sourceWidth, size_t sourceHeight, uint8_t *target, size_t targetWidth,
+                     size_t targetHeight, bool isSRGB);
+
+// Packs the red channel of the occlusion image, the green channel of the roughness image and the blue channel
+// of the metallic image into one opaque RGBA image, as used by the glTF occlusion and metallic-roughness textures.
+// The occlusion image is optional, without it the red channel is 255. All images have the same size.
+void packORM(const uint8_t *occlusion, const uint8_t *roughness, const uint8_t *metallic, uint8_t *target, size_t pixelCount);
+} // namespace kernels
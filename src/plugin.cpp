@@ -3,6 +3,7 @@
 #include "Arguments.h"
 #include "Exporter.h"
 #include "OutputStreamsPatch.h"
+#include "ThreadPool.h"
 #include "version.h"
 #include <maya/MFnPlugin.h>
 
@@ -16,6 +17,7 @@ MStatus initializePlugin(MObject obj) {
     status = plugin.registerCommand("maya2glTF", Exporter::createInstance,
                                     SyntaxFactory::createSyntax);
     CHECK_MSTATUS_AND_RETURN_IT(status);
+    ThreadPool::createShared();
     return status;
 }
 
@@ -24,5 +26,6 @@ MStatus uninitializePlugin(MObject obj) {
     MFnPlugin plugin(obj);
     status = plugin.deregisterCommand("maya2glTF");
     CHECK_MSTATUS_AND_RETURN_IT(status);
+    ThreadPool::destroyShared();
     return status;
 }
@@ -0,0 +1,105 @@
+#include "externals.h"
+
+#include "dump.h"
+#include "process.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char **environ;
+#endif
+
+#ifdef _WIN32
+static std::wstring toWide(const std::string &text) {
+    if (text.empty())
+        return std::wstring();
+
+    const auto length = MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), nullptr, 0);
+    std::wstring result(length, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), &result[0], length);
+    return result;
+}
+
+// Quotes the argument so that CommandLineToArgvW, and the C runtime, split it back into the same argument
+static void appendQuoted(std::wstring &commandLine, const std::wstring &argument) {
+    if (!commandLine.empty()) {
+        commandLine += L' ';
+    }
+
+    if (!argument.empty() && argument.find_first_of(L" \t\n\v\"") == std::wstring::npos) {
+        commandLine += argument;
+        return;
+    }
+
+    commandLine += L'"';
+
+    size_t backslashCount = 0;
+    for (const auto c : argument) {
+        if (c == L'\\') {
+            ++backslashCount;
+            continue;
+        }
+
+        // Backslashes are only special before a quote
+        commandLine.append(c == L'"' ? backslashCount * 2 + 1 : backslashCount, L'\\');
+        commandLine += c;
+        backslashCount = 0;
+    }
+
+    // Don't escape the closing quote
+    commandLine.append(backslashCount * 2, L'\\');
+    commandLine += L'"';
+}
+
+int runProcess(const std::vector<std::string> &arguments) {
+    std::wstring commandLine;
+    for (auto &argument : arguments) {
+        appendQuoted(commandLine, toWide(argument));
+    }
+
+    STARTUPINFOW startupInfo{};
+    startupInfo.cb = sizeof(startupInfo);
+
+    PROCESS_INFORMATION processInfo{};
+
+    // Without a console window, this runs on the worker threads
+    if (!CreateProcessW(nullptr, &commandLine[0], nullptr, nullptr, FALSE, CREATE_NO_WINDOW, nullptr, nullptr, &startupInfo,
+                        &processInfo))
+        throw std::runtime_error(formatted("Couldn't start '%s': error %lu", arguments.at(0).c_str(), GetLastError()));
+
+    WaitForSingleObject(processInfo.hProcess, INFINITE);
+
+    DWORD exitCode = 0;
+    GetExitCodeProcess(processInfo.hProcess, &exitCode);
+
+    CloseHandle(processInfo.hThread);
+    CloseHandle(processInfo.hProcess);
+
+    return static_cast<int>(exitCode);
+}
+#else
+int runProcess(const std::vector<std::string> &arguments) {
+    std::vector<char *> argv;
+    argv.reserve(arguments.size() + 1);
+    for (auto &argument : arguments) {
+        argv.push_back(const_cast<char *>(argument.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    pid_t pid;
+    const auto error = posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ);
+    if (error != 0)
+        throw std::runtime_error(formatted("Couldn't start '%s': %s", argv[0], strerror(error)));
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR)
+            throw std::runtime_error(formatted("Couldn't wait for '%s': %s", argv[0], strerror(errno)));
+    }
+
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+#endif
@@ -0,0 +1,6 @@
+#pragma once
+
+// Runs the executable with the arguments, without a shell, and waits until it exits.
+// The executable is searched on the PATH when it has no directory. The first argument is the executable itself.
+// Returns the exit code. Throws when the process can't be started. Doesn't use Maya, so it can run on any thread.
+int runProcess(const std::vector<std::string> &arguments);
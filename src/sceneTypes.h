@@ -183,3 +183,44 @@ inline Type type(const Semantic::Kind s) {
 }; // namespace Component
 
 typedef std::bitset<Semantic::COUNT> MeshSemanticSet;
+
+// The material slots a texture can be exported for
+namespace TextureSlot {
+enum Kind {
+    INVALID = -1,
+    BASE_COLOR,
+    NORMAL,
+    // Occlusion, roughness and metallic
+    ORM,
+    EMISSIVE,
+    COUNT
+};
+
+inline const char *name(const Kind s) {
+    switch (s) {
+    case BASE_COLOR:
+        return "baseColor";
+    case NORMAL:
+        return "normal";
+    case ORM:
+        return "orm";
+    case EMISSIVE:
+        return "emissive";
+    default:
+        assert(false);
+        return "unknown";
+    }
+}
+
+inline Kind parse(const std::string &s) {
+    for (auto i = 0; i < COUNT; ++i) {
+        const auto kind = static_cast<Kind>(i);
+        if (s == name(kind))
+            return kind;
+    }
+    return INVALID;
+}
+} // namespace TextureSlot
+
+// The maximum width and height of the textures per slot, 0 when unlimited
+typedef std::array<int, TextureSlot::COUNT> TextureSizes;
@@ -20,6 +20,11 @@ static gsl::span<const MColor> span(const MColorArray &marray) {
                                : gsl::span<const MColor>();
 }
 
+static gsl::span<const float> span(const MFloatArray &marray) {
+    return marray.length() > 0 ? gsl::make_span(&marray[0], marray.length())
+                               : gsl::span<const float>();
+}
+
 template <typename T, typename S>
 static gsl::span<const T> reinterpret_span(const gsl::span<S> &span) {
     assert(sizeof(S) >= sizeof(T) ? sizeof(S) % sizeof(T) == 0